@@ -0,0 +1,109 @@
+#include "attack_tables.h"
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "chess_board.h"
+
+using std::atomic;
+using std::invalid_argument;
+using std::lock_guard;
+using std::memory_order_acquire;
+using std::memory_order_release;
+using std::mutex;
+using std::to_string;
+using std::vector;
+
+// The jumps each leaper makes, in the order the pieces have always listed
+// their moves in.
+static vector<Cell> leaper_jumps(Leaper leaper) {
+    vector<Cell> jumps;
+    switch (leaper) {
+        case KING_LEAPS:
+            for (int dx = -1; dx <= 1; ++dx) {
+                for (int dy = -1; dy <= 1; ++dy) {
+                    if (dx != 0 || dy != 0) {
+                        jumps.emplace_back(dx, dy);
+                    }
+                }
+            }
+            break;
+        case KNIGHT_LEAPS:
+            jumps = {{-1, 2}, {1, 2}, {-2, 1}, {2, 1}, {-2, -1}, {2, -1}, {-1, -2}, {1, -2}};
+            break;
+        case BOMB_TOWER_LEAPS:
+            for (int dx = -2; dx <= 2; ++dx) {
+                for (int dy = -2; dy <= 2; ++dy) {
+                    jumps.emplace_back(dx, dy);
+                }
+            }
+            break;
+        case NUM_LEAPERS:
+            break;
+    }
+    return jumps;
+}
+
+AttackTables::AttackTables(int width, int height) : width(width), height(height) {
+    int num_squares = width * height;
+    int stride = width + 2 * Board::BORDER;
+    bool has_masks = num_squares <= 64;
+    if (has_masks) {
+        masks.assign(NUM_LEAPERS * num_squares, 0);
+    }
+
+    for (int leaper = 0; leaper < NUM_LEAPERS; ++leaper) {
+        vector<Cell> jumps = leaper_jumps(static_cast<Leaper>(leaper));
+        for (int square = 0; square < num_squares; ++square) {
+            int x = square % width, y = square / width;
+            first_target.push_back(targets.size());
+            for (Cell jump : jumps) {
+                int to_x = x + jump.x, to_y = y + jump.y;
+                if (to_x < 0 || to_x >= width || to_y < 0 || to_y >= height) {
+                    continue;
+                }
+                targets.push_back({static_cast<int8_t>(jump.x), static_cast<int8_t>(jump.y), static_cast<int16_t>(jump.y * stride + jump.x)});
+                if (has_masks && (jump.x != 0 || jump.y != 0)) {
+                    masks[leaper * num_squares + square] |= uint64_t(1) << (to_y * width + to_x);
+                }
+            }
+        }
+    }
+    first_target.push_back(targets.size());
+
+    if (has_masks) {
+        static const int steps[NUM_DIRECTIONS][2] = {{0, 1}, {1, 0}, {-1, 1}, {1, 1}, {0, -1}, {-1, 0}, {1, -1}, {-1, -1}};
+        rays.assign(NUM_DIRECTIONS * num_squares, 0);
+        for (int direction = 0; direction < NUM_DIRECTIONS; ++direction) {
+            for (int square = 0; square < num_squares; ++square) {
+                int x = square % width + steps[direction][0], y = square / width + steps[direction][1];
+                for (; x >= 0 && x < width && y >= 0 && y < height; x += steps[direction][0], y += steps[direction][1]) {
+                    rays[direction * num_squares + square] |= uint64_t(1) << (y * width + x);
+                }
+            }
+        }
+    }
+}
+
+const AttackTables &AttackTables::get(int width, int height) {
+    // Looking the tables up doesn't need the lock, only building them does.
+    static atomic<const AttackTables *> tables[27][100];
+    static mutex building_mutex;
+
+    if (width < 2 || width > 26 || height < 2 || height > 99) {
+        throw invalid_argument("there are no attack tables for a " + to_string(width) + " by " + to_string(height) + " board");
+    }
+    const AttackTables *found = tables[width][height].load(memory_order_acquire);
+    if (!found) {
+        lock_guard<mutex> lock(building_mutex);
+        found = tables[width][height].load(memory_order_acquire);
+        if (!found) {
+            found = new AttackTables(width, height);
+            tables[width][height].store(found, memory_order_release);
+        }
+    }
+    return *found;
+}
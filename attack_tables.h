@@ -0,0 +1,117 @@
+#ifndef _ATTACK_TABLES_H_
+#define _ATTACK_TABLES_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "bitboard.h"
+#include "chess_board.h"
+
+using std::vector;
+
+// Pieces that jump straight to squares a fixed distance away ("leapers"),
+// whichever squares are in between. Pawns only ever look at 3 squares, which
+// is quicker to do directly than with a table.
+enum Leaper {
+    KING_LEAPS,
+    KNIGHT_LEAPS,
+    // Every square up to 2 files and ranks away, including the square the
+    // bomb tower is on (that's how it explodes).
+    BOMB_TOWER_LEAPS,
+    NUM_LEAPERS
+};
+
+// The directions pieces slide in. Going UP (towards black's side), RIGHT,
+// UP_LEFT or UP_RIGHT goes to higher numbered squares, the rest go to lower
+// numbered ones.
+enum Direction {
+    UP,
+    RIGHT,
+    UP_LEFT,
+    UP_RIGHT,
+    DOWN,
+    LEFT,
+    DOWN_RIGHT,
+    DOWN_LEFT,
+    NUM_DIRECTIONS
+};
+
+// One square a leaper can jump to: (dx, dy) away, which is index_offset
+// further along in the Board's square array.
+struct LeaperTarget {
+    int8_t dx, dy;
+    int16_t index_offset;
+};
+
+// Everything about where pieces can go that only depends on the size of the
+// board, worked out once per size (see get) and shared by every board of that
+// size. Squares are numbered y * width + x, like bitboard bits.
+class AttackTables {
+    int width, height;
+    // The targets of each leaper from each square, one square after another
+    // (so the targets of leaper from square start at
+    // first_target[leaper * width * height + square]). Targets off the board
+    // are left out, so the move generators don't have to look at them.
+    vector<LeaperTarget> targets;
+    vector<uint32_t> first_target;
+    // The same targets as bitboards, for boards with at most 64 squares
+    // (empty otherwise). A bomb tower's own square isn't in its mask.
+    vector<uint64_t> masks;
+    // For boards with at most 64 squares (empty otherwise): the squares from
+    // each square to the edge of the board in each direction, at
+    // rays[direction * width * height + square].
+    vector<uint64_t> rays;
+
+    AttackTables(int width, int height);
+
+   public:
+    struct Targets {
+        const LeaperTarget *first, *last;
+        const LeaperTarget *begin() const {
+            return first;
+        }
+        const LeaperTarget *end() const {
+            return last;
+        }
+    };
+
+    // The squares on the board that leaper can jump to from from, in the
+    // same order every time.
+    Targets leaper_targets(Leaper leaper, Cell from) const {
+        const uint32_t *first = &first_target[(leaper * height + from.y) * width + from.x];
+        return {targets.data() + first[0], targets.data() + first[1]};
+    }
+    // The same squares as a bitboard. Only boards with at most 64 squares
+    // have these.
+    uint64_t leaper_mask(Leaper leaper, int square) const {
+        return masks[leaper * width * height + square];
+    }
+
+    // The squares from square (not including it) to the edge of the board in
+    // direction. Only boards with at most 64 squares have these, and so do
+    // the functions below.
+    uint64_t ray_mask(Direction direction, int square) const {
+        return rays[direction * width * height + square];
+    }
+    // Of squares (which are all on one ray in direction), the one closest to
+    // where the ray starts.
+    static int nearest_square(Direction direction, uint64_t squares) {
+        return direction < DOWN ? lowest_bit(squares) : highest_bit(squares);
+    }
+    // Where a piece on square can slide in direction when there are pieces
+    // on the squares in occupied: every square up to (and including) the
+    // first piece in the way. Since the rest of the ray starts at that
+    // piece, it's just two lookups.
+    uint64_t slide_mask(Direction direction, int square, uint64_t occupied) const {
+        uint64_t ray = ray_mask(direction, square);
+        uint64_t blockers = ray & occupied;
+        return blockers ? ray ^ ray_mask(direction, nearest_square(direction, blockers)) : ray;
+    }
+
+    // The tables of a width by height board. Built the first time they're
+    // asked for and kept forever. Throws invalid_argument if there can't be
+    // a board that size (2 to 26 by 2 to 99).
+    static const AttackTables &get(int width, int height);
+};
+
+#endif  // _ATTACK_TABLES_H_
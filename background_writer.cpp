@@ -0,0 +1,52 @@
+#include "background_writer.h"
+
+#include <ios>
+#include <stdexcept>
+
+using std::ios;
+using std::lock_guard;
+using std::mutex;
+using std::runtime_error;
+using std::unique_lock;
+
+BackgroundWriter::BackgroundWriter(const string &file_name) : file(file_name, ios::binary), closing(false) {
+    if (!file) {
+        throw runtime_error("can't open " + file_name + " for writing");
+    }
+    thread = std::thread(&BackgroundWriter::write_pending, this);
+}
+
+BackgroundWriter::~BackgroundWriter() {
+    {
+        lock_guard<mutex> lock(pending_mutex);
+        closing = true;
+    }
+    wake_up.notify_one();
+    thread.join();
+}
+
+void BackgroundWriter::write(const string &bytes) {
+    {
+        lock_guard<mutex> lock(pending_mutex);
+        pending += bytes;
+    }
+    wake_up.notify_one();
+}
+
+void BackgroundWriter::write_pending() {
+    string writing;
+    unique_lock<mutex> lock(pending_mutex);
+    while (true) {
+        wake_up.wait(lock, [&]() { return closing || !pending.empty(); });
+        if (pending.empty()) {
+            break;  // closing, and everything's been written
+        }
+        // write without the lock, so nobody has to wait for the disk
+        writing.swap(pending);
+        lock.unlock();
+        file.write(writing.data(), writing.size());
+        writing.clear();
+        lock.lock();
+    }
+    file.flush();
+}
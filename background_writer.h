@@ -0,0 +1,39 @@
+#ifndef _BACKGROUND_WRITER_H_
+#define _BACKGROUND_WRITER_H_
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using std::string;
+
+// Writes to a file from a thread of its own, so whoever is writing only has
+// to wait for the bytes to be copied into a buffer, never for the disk. The
+// thread writes everything that's piled up in one go. Safe to write to from
+// many threads at once. Everything written is in the file once the writer
+// has been destroyed.
+class BackgroundWriter {
+    std::ofstream file;
+    std::mutex pending_mutex;
+    std::condition_variable wake_up;
+    // What's been written since the thread last took the bytes.
+    string pending;
+    bool closing;
+    std::thread thread;
+
+    void write_pending();
+
+   public:
+    // Throws runtime_error if the file can't be opened.
+    explicit BackgroundWriter(const string &file_name);
+    ~BackgroundWriter();
+
+    BackgroundWriter(const BackgroundWriter &) = delete;
+    BackgroundWriter &operator=(const BackgroundWriter &) = delete;
+
+    void write(const string &bytes);
+};
+
+#endif  // _BACKGROUND_WRITER_H_
@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "chess_board.h"
+#include "chess_pieces.h"
+#include "chess_player.h"
+#include "position_notation.h"
+#include "utf8_codepoint.h"
+
+using namespace std;
+
+// Times the hot paths one at a time.
+//
+// usage: benchmark [options]
+//   --format json|csv    how to write the results (default json)
+//   --output FILE        write the results to FILE instead of the screen
+//   --filter TEXT        only run the benchmarks with TEXT in their name
+//   --min-time MS        time each benchmark for at least MS milliseconds (default 100)
+//   --baseline FILE      compare with the results (json or csv) in FILE, and
+//                        exit with 1 if anything got slower by more than...
+//   --threshold PERCENT  ...this much (default 10)
+// Everything other than the results is written to cerr.
+
+struct Result {
+    string name;
+    double ns_per_op;
+    uint64_t iterations;
+};
+
+// Stops the compiler from optimizing away work whose result isn't used.
+volatile uint64_t sink;
+
+// Runs op enough times to take min_time, 5 times over, and keeps the fastest
+// (the others were slowed down by something else).
+Result time_op(const string &name, chrono::nanoseconds min_time, const function<void()> &op) {
+    uint64_t iterations = 1;
+    double best = 0;
+    for (int run = 0; run < 5;) {
+        auto start = chrono::steady_clock::now();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            op();
+        }
+        chrono::nanoseconds took = chrono::steady_clock::now() - start;
+        if (took * 5 < min_time) {
+            iterations *= 2;  // too short to time accurately
+            continue;
+        }
+        double ns_per_op = static_cast<double>(took.count()) / iterations;
+        if (run == 0 || ns_per_op < best) {
+            best = ns_per_op;
+        }
+        ++run;
+    }
+    return {name, best, iterations};
+}
+
+const char *PIECE_TYPE_NAMES[NUM_PIECE_TYPES] = {"empty", "king", "queen", "bishop", "knight", "rook", "pawn", "cannon", "bomb_tower", "custom"};
+
+// a board with every kind of piece on it
+const char *CUSTOM_PIECES_BOARD =
+    "   abcdefgh\n"
+    " 8 ♜.▼.♚..★ 8\n"
+    " 7 ♟♟.♟♟.♟♟ 7\n"
+    " 6 ..♝.☆... 6\n"
+    " 5 .▽..♟.▼. 5\n"
+    " 4 ..♙.♘... 4\n"
+    " 3 ▽....♕.. 3\n"
+    " 2 ♙☆♙.♙♙♙♙ 2\n"
+    " 1 ♖..♔..▽♖ 1\n"
+    "   abcdefgh\n";
+
+Board read_board(const string &text) {
+    istringstream in(text);
+    Board board;
+    in >> board;
+    return board;
+}
+
+// An 8 by 8 board with piece in the middle (on d4), with pieces of both
+// teams in some of the squares it can reach.
+Board board_with_piece_in_middle(const ChessPiece &piece) {
+    ostringstream text;
+    text << "   abcdefgh\n"
+         << " 8 ♜.....♚. 8\n"
+         << " 7 ...♟.... 7\n"
+         << " 6 .♟...♙.. 6\n"
+         << " 5 ........ 5\n"
+         << " 4 .♙." << piece << "...♟ 4\n"
+         << " 3 ..♟.♙... 3\n"
+         << " 2 ........ 2\n"
+         << " 1 ♖..♔.... 1\n"
+         << "   abcdefgh\n";
+    Board board = read_board(text.str());
+    board.set_current_teams_turn(piece.team);
+    return board;
+}
+
+vector<Result> run_benchmarks(const string &filter, chrono::nanoseconds min_time) {
+    vector<Result> results;
+    auto run = [&](const string &name, const function<void()> &op) {
+        if (name.find(filter) == string::npos) {
+            return;
+        }
+        cerr << name << "... " << flush;
+        results.push_back(time_op(name, min_time, op));
+        cerr << results.back().ns_per_op << " ns" << endl;
+    };
+
+    // each piece's own move generation
+    for (const auto &code_point_and_piece : ALL_CHESS_PIECES) {
+        const ChessPiece &piece = *code_point_and_piece.second;
+        if (piece.team == NONE) {
+            continue;
+        }
+        Board board = board_with_piece_in_middle(piece);
+        MoveList moves;
+        run(string("piece_get_moves/") + team_name(piece.team) + "_" + PIECE_TYPE_NAMES[piece.type], [&]() {
+            moves.clear();
+            piece.get_moves(board, Cell(3, 3), moves);
+            sink = moves.size();
+        });
+    }
+
+    map<string, Board> boards = {
+        {"start_8x8", Board()},
+        {"custom_pieces_8x8", read_board(CUSTOM_PIECES_BOARD)},
+        {"start_11x13", Board(11, 13)},
+        {"start_26x99", Board(26, 99)},
+    };
+    for (const auto &name_and_board : boards) {
+        const string &name = name_and_board.first;
+        const Board &board = name_and_board.second;
+        run("board_get_moves/" + name, [&]() {
+            sink = board.get_moves().size();
+        });
+        run("board_get_captures/" + name, [&]() {
+            sink = board.get_captures().size();
+        });
+        run("board_winner/" + name, [&]() {
+            sink = board.winner();
+        });
+        run("board_copy/" + name, [&]() {
+            Board copy = board;
+            sink = copy.get_width();
+        });
+        ostringstream written;
+        written << board;
+        string text = written.str();
+        run("board_write/" + name, [&]() {
+            ostringstream out;
+            out << board;
+            sink = out.tellp();
+        });
+        run("board_read/" + name, [&]() {
+            istringstream in(text);
+            Board read;
+            in >> read;
+            sink = read.get_width();
+        });
+        string position = write_position(board);
+        run("position_write/" + name, [&]() {
+            string out;
+            write_position(board, out);
+            sink = out.size();
+        });
+        Board read;
+        run("position_read/" + name, [&]() {
+            read_position(position, read);
+            sink = read.get_width();
+        });
+    }
+
+    // every piece's code point, plus one of each length
+    vector<UTF8CodePoint> code_points = {U'a', U'é', U'€', U'😀'};
+    for (const auto &code_point_and_piece : ALL_CHESS_PIECES) {
+        code_points.push_back(code_point_and_piece.first);
+    }
+    ostringstream encoded;
+    for (UTF8CodePoint code_point : code_points) {
+        encoded << code_point;
+    }
+    string encoded_text = encoded.str();
+    run("utf8_encode", [&]() {
+        ostringstream out;
+        for (UTF8CodePoint code_point : code_points) {
+            out << code_point;
+        }
+        sink = out.tellp();
+    });
+    run("utf8_decode", [&]() {
+        istringstream in(encoded_text);
+        UTF8CodePoint code_point;
+        uint64_t total = 0;
+        while (in >> code_point) {
+            total += code_point;
+        }
+        sink = total;
+    });
+
+    // a fresh AI each time, so that it can't remember the answer from last time
+    for (string name : {"start_8x8", "custom_pieces_8x8"}) {
+        const Board &board = boards[name];
+        MoveList moves = board.get_moves();
+        run("ai_get_move/" + name + "/depth_4", [&]() {
+            AIPlayer ai(board.get_current_teams_turn(), 1, 4);
+            sink = ai.get_move(board, moves).to.x;
+        });
+    }
+    return results;
+}
+
+void write_results(ostream &os, const vector<Result> &results, const string &format) {
+    if (format == "csv") {
+        os << "name,ns_per_op,iterations\n";
+        for (const Result &result : results) {
+            os << result.name << ',' << result.ns_per_op << ',' << result.iterations << '\n';
+        }
+        return;
+    }
+    os << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        os << "    {\"name\": \"" << results[i].name << "\", \"ns_per_op\": " << results[i].ns_per_op
+           << ", \"iterations\": " << results[i].iterations << "}" << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+    os << "  ]\n}\n";
+}
+
+// Reads results written by write_results (in either format).
+map<string, double> read_results(istream &is) {
+    map<string, double> ns_per_op;
+    string line;
+    while (getline(is, line)) {
+        size_t name_start = line.find("\"name\": \"");
+        if (name_start != string::npos) {
+            // json: one benchmark per line
+            name_start += strlen("\"name\": \"");
+            string name = line.substr(name_start, line.find('"', name_start) - name_start);
+            size_t number_start = line.find("\"ns_per_op\": ");
+            if (number_start != string::npos) {
+                ns_per_op[name] = atof(line.c_str() + number_start + strlen("\"ns_per_op\": "));
+            }
+        } else if (line.find(',') != string::npos && line.rfind("name,", 0) != 0) {
+            // csv
+            size_t comma = line.find(',');
+            ns_per_op[line.substr(0, comma)] = atof(line.c_str() + comma + 1);
+        }
+    }
+    return ns_per_op;
+}
+
+// Says how each benchmark changed since the baseline. Returns how many got
+// slower by more than threshold_percent.
+int compare_results(const vector<Result> &results, const map<string, double> &baseline, double threshold_percent) {
+    int num_regressions = 0;
+    for (const Result &result : results) {
+        auto base = baseline.find(result.name);
+        if (base == baseline.end() || base->second <= 0) {
+            cerr << result.name << ": not in the baseline" << endl;
+            continue;
+        }
+        double change_percent = (result.ns_per_op - base->second) / base->second * 100;
+        bool regressed = change_percent > threshold_percent;
+        num_regressions += regressed;
+        cerr << result.name << ": " << base->second << " ns -> " << result.ns_per_op << " ns ("
+             << (change_percent >= 0 ? "+" : "") << change_percent << "%)" << (regressed ? "  REGRESSION" : "") << endl;
+    }
+    return num_regressions;
+}
+
+int main(int argc, const char *argv[]) {
+    string format = "json", output, filter, baseline;
+    double threshold_percent = 10;
+    int min_time_ms = 100;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "expected a value after " << arg << endl;
+            return 2;
+        }
+        if (arg == "--format") {
+            format = argv[++i];
+        } else if (arg == "--output") {
+            output = argv[++i];
+        } else if (arg == "--filter") {
+            filter = argv[++i];
+        } else if (arg == "--min-time") {
+            min_time_ms = atoi(argv[++i]);
+        } else if (arg == "--baseline") {
+            baseline = argv[++i];
+        } else if (arg == "--threshold") {
+            threshold_percent = atof(argv[++i]);
+        } else {
+            cerr << "unknown option " << arg << endl;
+            return 2;
+        }
+    }
+    if (format != "json" && format != "csv") {
+        cerr << "--format must be json or csv" << endl;
+        return 2;
+    }
+
+    vector<Result> results = run_benchmarks(filter, chrono::milliseconds(min_time_ms));
+
+    if (output.empty()) {
+        write_results(cout, results, format);
+    } else {
+        ofstream out(output);
+        write_results(out, results, format);
+    }
+
+    if (!baseline.empty()) {
+        ifstream in(baseline);
+        if (!in) {
+            cerr << "can't open " << baseline << endl;
+            return 2;
+        }
+        int num_regressions = compare_results(results, read_results(in), threshold_percent);
+        cerr << num_regressions << " regression(s) of more than " << threshold_percent << "%" << endl;
+        return num_regressions == 0 ? 0 : 1;
+    }
+    return 0;
+}
@@ -0,0 +1,267 @@
+#include "bitboard.h"
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#include "attack_tables.h"
+#include "chess_board.h"
+#include "chess_pieces.h"
+
+using std::atomic;
+using std::invalid_argument;
+using std::lock_guard;
+using std::memory_order_acquire;
+using std::memory_order_release;
+using std::mutex;
+using std::to_string;
+
+template <typename Bits>
+BitboardGeometry<Bits>::BitboardGeometry(int width, int height) : width(width), height(height), all() {
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            set_bit(all, y * width + x);
+        }
+    }
+
+    for (int dx = -2; dx <= 2; ++dx) {
+        Bits keep = Bits();
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                // after shifting dx files right, only files dx.. (or ..width + dx) are real
+                if (x - dx >= 0 && x - dx < width) {
+                    set_bit(keep, y * width + x);
+                }
+            }
+        }
+        keep_after_shift[dx + 2] = keep;
+    }
+}
+
+template <typename Bits>
+Cell BitboardGeometry<Bits>::cell(int bit) const {
+    return Cell(bit % width, bit / width);
+}
+
+template <typename Bits>
+const BitboardGeometry<Bits> &BitboardGeometry<Bits>::get(int width, int height) {
+    // Looking a geometry up doesn't need the lock, only building one does.
+    static atomic<const BitboardGeometry *> geometries[27][100];
+    static mutex building_mutex;
+
+    if (width < 2 || width > 26 || height < 2 || height > 99) {
+        throw invalid_argument("there's no bitboard geometry for a " + to_string(width) + " by " + to_string(height) + " board");
+    }
+    const BitboardGeometry *geometry = geometries[width][height].load(memory_order_acquire);
+    if (!geometry) {
+        lock_guard<mutex> lock(building_mutex);
+        geometry = geometries[width][height].load(memory_order_acquire);
+        if (!geometry) {
+            geometry = new BitboardGeometry(width, height);
+            geometries[width][height].store(geometry, memory_order_release);
+        }
+    }
+    return *geometry;
+}
+
+// Which squares hold each type of piece and each team's pieces.
+template <typename Bits>
+struct Bitboards {
+    Bits types[NUM_PIECE_TYPES];
+    Bits teams[3];
+};
+
+static const Direction ROOK_DIRECTIONS[4] = {UP, LEFT, RIGHT, DOWN};
+static const Direction BISHOP_DIRECTIONS[4] = {UP_LEFT, UP_RIGHT, DOWN_LEFT, DOWN_RIGHT};
+
+// The moves of a piece that jumps straight to (dx, dy) away. Every piece in
+// pieces jumps at the same time, and since they all jump the same way, each
+// target can only have come from one square. The moves all get flags (see
+// PackedMove).
+template <typename Bits>
+static void add_jumps(const BitboardGeometry<Bits> &geometry, const Bits &pieces, int dx, int dy, const Bits &allowed, uint32_t flags, MoveList &moves) {
+    Bits targets = geometry.shift(pieces, dx, dy) & allowed;
+    for_each_bit(targets, [&](int bit) {
+        Cell to = geometry.cell(bit);
+        moves.emplace_back(Cell(to.x - dx, to.y - dy), to, flags);
+    });
+}
+
+// Adds a move from from to each square in targets (the ones with an enemy
+// on them are captures).
+static void add_moves_to(const BitboardGeometry<uint64_t> &geometry, Cell from, uint64_t targets, uint64_t enemy, MoveList &moves) {
+    for_each_bit(targets & ~enemy, [&](int bit) {
+        moves.emplace_back(from, geometry.cell(bit));
+    });
+    for_each_bit(targets & enemy, [&](int bit) {
+        moves.emplace_back(from, geometry.cell(bit), PackedMove::CAPTURE);
+    });
+}
+
+// The moves of leapers (see attack_tables.h) onto the allowed squares. Each
+// piece's targets are a single precomputed mask.
+static void add_leaps(const BitboardGeometry<uint64_t> &geometry, const AttackTables &tables, uint64_t pieces, Leaper leaper, uint64_t allowed, uint64_t enemy, MoveList &moves) {
+    for_each_bit(pieces, [&](int bit) {
+        add_moves_to(geometry, geometry.cell(bit), tables.leaper_mask(leaper, bit) & allowed, enemy, moves);
+    });
+}
+
+// The moves of pieces that slide in the 4 directions until they hit
+// something (capturing it if it's allowed to).
+static void add_slides(const BitboardGeometry<uint64_t> &geometry, const AttackTables &tables, uint64_t pieces, const Direction *directions, uint64_t occupied, uint64_t allowed, uint64_t enemy, MoveList &moves) {
+    for_each_bit(pieces, [&](int bit) {
+        uint64_t targets = 0;
+        for (int i = 0; i < 4; ++i) {
+            targets |= tables.slide_mask(directions[i], bit, occupied);
+        }
+        add_moves_to(geometry, geometry.cell(bit), targets & allowed, enemy, moves);
+    });
+}
+
+// Cannons slide like rooks, but only onto empty squares. They capture by
+// jumping over the first piece in the way (the screen) and hitting the next
+// piece behind it, if that one is on the other team. The ray behind the
+// screen starts at the screen, so finding that piece is one more lookup.
+// Only the targets in allowed are added.
+static void add_cannon_moves(const BitboardGeometry<uint64_t> &geometry, const AttackTables &tables, uint64_t cannons, uint64_t occupied, uint64_t allowed, uint64_t enemy, MoveList &moves) {
+    for_each_bit(cannons, [&](int bit) {
+        uint64_t targets = 0;
+        for (Direction direction : ROOK_DIRECTIONS) {
+            uint64_t ray = tables.ray_mask(direction, bit);
+            uint64_t blockers = ray & occupied;
+            if (!blockers) {
+                targets |= ray;
+                continue;
+            }
+            uint64_t behind_screen = tables.ray_mask(direction, AttackTables::nearest_square(direction, blockers));
+            targets |= (ray ^ behind_screen) & ~occupied;
+            uint64_t hurdles = behind_screen & occupied;
+            if (hurdles) {
+                int target = AttackTables::nearest_square(direction, hurdles);
+                targets |= enemy & uint64_t(1) << target;
+            }
+        }
+        add_moves_to(geometry, geometry.cell(bit), targets & allowed, enemy, moves);
+    });
+}
+
+// The moves (or only the captures) of everything but the pawns. Shifting a
+// WideBitboard touches every one of its words, which on big boards costs a
+// lot more than letting each piece walk the (framed) squares it can actually
+// reach. So bigger boards only use bitboards to find the pieces (skipping the
+// empty parts of the board a word at a time)...
+template <typename Bits>
+static void add_piece_moves(const Board &board, const BitboardGeometry<Bits> &geometry, const Bitboards<Bits> &bitboards, Team us, bool captures_only, MoveList &moves) {
+    for_each_bit(bitboards.teams[us] & ~bitboards.types[PAWN], [&](int bit) {
+        if (captures_only) {
+            get_piece_captures(board, geometry.cell(bit), moves);
+        } else {
+            get_piece_moves(board, geometry.cell(bit), moves);
+        }
+    });
+}
+
+// ...and boards that fit in a uint64_t look every piece's moves up in the
+// attack tables (see attack_tables.h).
+static void add_piece_moves(const Board &board, const BitboardGeometry<uint64_t> &geometry, const Bitboards<uint64_t> &bitboards, Team us, bool captures_only, MoveList &moves) {
+    const AttackTables &tables = board.get_attack_tables();
+    Team them = us == WHITE ? BLACK : WHITE;
+    uint64_t own = bitboards.teams[us];
+    uint64_t enemy = bitboards.teams[them];
+    uint64_t empty = bitboards.types[EMPTY];
+    uint64_t occupied = bitboards.teams[WHITE] | bitboards.teams[BLACK];
+    uint64_t allowed = captures_only ? enemy : empty | enemy;
+
+    add_leaps(geometry, tables, bitboards.types[KING] & own, KING_LEAPS, allowed, enemy, moves);
+    add_leaps(geometry, tables, bitboards.types[KNIGHT] & own, KNIGHT_LEAPS, allowed, enemy, moves);
+
+    uint64_t bomb_towers = bitboards.types[BOMB_TOWER] & own;
+    if (any(bomb_towers)) {
+        // a bomb tower can go anywhere in a 2 by 2 square...
+        add_leaps(geometry, tables, bomb_towers, BOMB_TOWER_LEAPS, allowed, enemy, moves);
+        // ...or stay put and explode (which only captures something if
+        // there's an enemy in range)
+        uint64_t exploding = bomb_towers;
+        if (captures_only) {
+            for_each_bit(bomb_towers, [&](int bit) {
+                if (!(tables.leaper_mask(BOMB_TOWER_LEAPS, bit) & enemy)) {
+                    clear_bit(exploding, bit);
+                }
+            });
+        }
+        add_jumps(geometry, bomb_towers, 0, 0, exploding, PackedMove::EXPLOSION, moves);
+    }
+
+    uint64_t queens = bitboards.types[QUEEN] & own;
+    add_slides(geometry, tables, (bitboards.types[ROOK] & own) | queens, ROOK_DIRECTIONS, occupied, allowed, enemy, moves);
+    add_slides(geometry, tables, (bitboards.types[BISHOP] & own) | queens, BISHOP_DIRECTIONS, occupied, allowed, enemy, moves);
+    add_cannon_moves(geometry, tables, bitboards.types[CANNON] & own, occupied, allowed, enemy, moves);
+
+    // pieces we don't know how to handle with bitboards
+    for_each_bit(bitboards.types[CUSTOM] & own, [&](int bit) {
+        if (captures_only) {
+            get_custom_piece_captures(board, geometry.cell(bit), moves);
+        } else {
+            get_custom_piece_moves(board, geometry.cell(bit), moves);
+        }
+    });
+}
+
+template <typename Bits>
+static void generate_moves(const Board &board, const uint64_t *words, int num_words, bool captures_only, MoveList &moves) {
+    const BitboardGeometry<Bits> &geometry = BitboardGeometry<Bits>::get(board.get_width(), board.get_height());
+    Bitboards<Bits> bitboards;
+    for (int type = 0; type < NUM_PIECE_TYPES; ++type) {
+        load_bits(bitboards.types[type], words + type * num_words, num_words);
+    }
+    for (int team = 0; team < 3; ++team) {
+        load_bits(bitboards.teams[team], words + (NUM_PIECE_TYPES + team) * num_words, num_words);
+    }
+
+    Team us = board.get_current_teams_turn();
+    Team them = us == WHITE ? BLACK : WHITE;
+
+    // pawns all move at the same time
+    Bits pawns = bitboards.types[PAWN] & bitboards.teams[us];
+    if (any(pawns)) {
+        int forward = us == WHITE ? 1 : -1;
+        if (!captures_only) {
+            add_jumps(geometry, pawns, 0, forward, bitboards.types[EMPTY], 0, moves);
+        }
+        add_jumps(geometry, pawns, -1, forward, bitboards.teams[them], PackedMove::CAPTURE, moves);
+        add_jumps(geometry, pawns, 1, forward, bitboards.teams[them], PackedMove::CAPTURE, moves);
+    }
+
+    add_piece_moves(board, geometry, bitboards, us, captures_only, moves);
+}
+
+static void generate_with_smallest_bitboard(const Board &board, const uint64_t *words, int num_words, bool captures_only, MoveList &moves) {
+    // use the smallest bitboard that fits, so small boards don't pay for the
+    // words only big boards need
+    if (num_words == 1) {
+        generate_moves<uint64_t>(board, words, num_words, captures_only, moves);
+    } else if (num_words <= 2) {
+        generate_moves<WideBitboard<2>>(board, words, num_words, captures_only, moves);
+    } else if (num_words <= 4) {
+        generate_moves<WideBitboard<4>>(board, words, num_words, captures_only, moves);
+    } else if (num_words <= 8) {
+        generate_moves<WideBitboard<8>>(board, words, num_words, captures_only, moves);
+    } else if (num_words <= 16) {
+        generate_moves<WideBitboard<16>>(board, words, num_words, captures_only, moves);
+    } else if (num_words <= 24) {
+        generate_moves<WideBitboard<24>>(board, words, num_words, captures_only, moves);
+    } else if (num_words <= 32) {
+        generate_moves<WideBitboard<32>>(board, words, num_words, captures_only, moves);
+    } else {
+        generate_moves<WideBitboard<MAX_BITBOARD_WORDS>>(board, words, num_words, captures_only, moves);
+    }
+}
+
+void get_bitboard_moves(const Board &board, MoveList &moves) {
+    generate_with_smallest_bitboard(board, board.bitboards.data(), board.words_per_bitboard, false, moves);
+}
+
+void get_bitboard_captures(const Board &board, MoveList &moves) {
+    generate_with_smallest_bitboard(board, board.bitboards.data(), board.words_per_bitboard, true, moves);
+}
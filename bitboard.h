@@ -0,0 +1,232 @@
+#ifndef _BITBOARD_H_
+#define _BITBOARD_H_
+
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+class Board;
+struct Cell;
+struct Move;
+class MoveList;
+
+// A bitboard is a set of squares stored as one bit per square, where square
+// (x, y) is bit y * width + x. Boards with at most 64 squares fit in a
+// uint64_t, bigger ones (up to 26 x 99) use a WideBitboard with just enough
+// words. Both support the same operations, so most of the move generator is
+// written once for every size (see get_bitboard_moves).
+
+inline int pop_count(uint64_t bits) {
+    return __builtin_popcountll(bits);
+}
+
+// Index of the lowest set bit. bits must not be 0.
+inline int lowest_bit(uint64_t bits) {
+    return __builtin_ctzll(bits);
+}
+
+// Index of the highest set bit. bits must not be 0.
+inline int highest_bit(uint64_t bits) {
+    return 63 - __builtin_clzll(bits);
+}
+
+inline bool any(uint64_t bits) {
+    return bits != 0;
+}
+
+inline bool test_bit(uint64_t bits, int bit) {
+    return bits >> bit & 1;
+}
+
+inline void set_bit(uint64_t &bits, int bit) {
+    bits |= uint64_t(1) << bit;
+}
+
+inline void clear_bit(uint64_t &bits, int bit) {
+    bits &= ~(uint64_t(1) << bit);
+}
+
+// Moves every bit `amount` places up (or down, if amount is negative).
+inline uint64_t shift_bits(uint64_t bits, int amount) {
+    if (amount >= 0) {
+        return amount < 64 ? bits << amount : 0;
+    }
+    return amount > -64 ? bits >> -amount : 0;
+}
+
+// Calls f(bit) for every set bit, lowest first.
+template <typename F>
+inline void for_each_bit(uint64_t bits, F f) {
+    for (; bits; bits &= bits - 1) {
+        f(lowest_bit(bits));
+    }
+}
+
+// Copies the first num_words words of a bitboard in/out of plain storage.
+inline void load_bits(uint64_t &bits, const uint64_t *words, int) {
+    bits = words[0];
+}
+
+// The biggest board (26 x 99 = 2574 squares) needs 41 words.
+constexpr int MAX_BITBOARD_WORDS = 41;
+
+// A bitboard made of N 64-bit words. The loops are simple and fixed-length,
+// so the compiler can unroll them and turn them into SSE/AVX2 code
+// (e.g. with -O3 -march=native).
+template <int N>
+struct alignas(32) WideBitboard {
+    uint64_t words[N];
+
+    WideBitboard() : words() {}
+
+    WideBitboard &operator&=(const WideBitboard &other) {
+        for (int i = 0; i < N; ++i) {
+            words[i] &= other.words[i];
+        }
+        return *this;
+    }
+    WideBitboard &operator|=(const WideBitboard &other) {
+        for (int i = 0; i < N; ++i) {
+            words[i] |= other.words[i];
+        }
+        return *this;
+    }
+};
+
+template <int N>
+inline WideBitboard<N> operator&(WideBitboard<N> a, const WideBitboard<N> &b) {
+    return a &= b;
+}
+
+template <int N>
+inline WideBitboard<N> operator|(WideBitboard<N> a, const WideBitboard<N> &b) {
+    return a |= b;
+}
+
+template <int N>
+inline WideBitboard<N> operator~(const WideBitboard<N> &a) {
+    WideBitboard<N> result;
+    for (int i = 0; i < N; ++i) {
+        result.words[i] = ~a.words[i];
+    }
+    return result;
+}
+
+template <int N>
+inline int pop_count(const WideBitboard<N> &bits) {
+    int count = 0;
+    for (uint64_t word : bits.words) {
+        count += pop_count(word);
+    }
+    return count;
+}
+
+template <int N>
+inline bool any(const WideBitboard<N> &bits) {
+    uint64_t all_words = 0;
+    for (uint64_t word : bits.words) {
+        all_words |= word;
+    }
+    return all_words != 0;
+}
+
+template <int N>
+inline bool test_bit(const WideBitboard<N> &bits, int bit) {
+    return test_bit(bits.words[bit / 64], bit % 64);
+}
+
+template <int N>
+inline void set_bit(WideBitboard<N> &bits, int bit) {
+    set_bit(bits.words[bit / 64], bit % 64);
+}
+
+template <int N>
+inline void clear_bit(WideBitboard<N> &bits, int bit) {
+    clear_bit(bits.words[bit / 64], bit % 64);
+}
+
+template <int N>
+inline WideBitboard<N> shift_bits(const WideBitboard<N> &bits, int amount) {
+    WideBitboard<N> result;
+    int word_shift = (amount >= 0 ? amount : -amount) / 64;
+    int bit_shift = (amount >= 0 ? amount : -amount) % 64;
+    if (word_shift >= N) {
+        return result;
+    }
+
+    // words shifted in from past either end are 0
+    uint64_t padded[N + 2];
+    padded[0] = padded[N + 1] = 0;
+    for (int i = 0; i < N; ++i) {
+        padded[i + 1] = bits.words[i];
+    }
+    if (amount >= 0) {
+        for (int i = word_shift; i < N; ++i) {
+            uint64_t low = padded[i - word_shift];  // the word below bits.words[i - word_shift]
+            result.words[i] = padded[i - word_shift + 1] << bit_shift | (bit_shift ? low >> (64 - bit_shift) : 0);
+        }
+    } else {
+        for (int i = 0; i + word_shift < N; ++i) {
+            uint64_t high = padded[i + word_shift + 2];  // the word above bits.words[i + word_shift]
+            result.words[i] = padded[i + word_shift + 1] >> bit_shift | (bit_shift ? high << (64 - bit_shift) : 0);
+        }
+    }
+    return result;
+}
+
+template <int N, typename F>
+inline void for_each_bit(const WideBitboard<N> &bits, F f) {
+    for (int i = 0; i < N; ++i) {
+        for (uint64_t word = bits.words[i]; word; word &= word - 1) {
+            f(i * 64 + lowest_bit(word));
+        }
+    }
+}
+
+template <int N>
+inline void load_bits(WideBitboard<N> &bits, const uint64_t *words, int num_words) {
+    for (int i = 0; i < N; ++i) {
+        bits.words[i] = i < num_words ? words[i] : 0;
+    }
+}
+
+// The masks needed to move bitboards around on a width by height board.
+// There's one of these per board size (see get), shared by every board.
+template <typename Bits>
+struct BitboardGeometry {
+    int width, height;
+    Bits all;  // every square on the board
+    // keep_after_shift[dx + 2] removes the squares that wrapped around to the
+    // other side of the board after shifting everything dx files to the right.
+    Bits keep_after_shift[5];
+
+    BitboardGeometry(int width, int height);
+
+    // Moves every square in bits dx files right and dy ranks up, dropping
+    // the ones that fall off the board. dx must be between -2 and 2.
+    Bits shift(const Bits &bits, int dx, int dy) const {
+        return shift_bits(bits, dy * width + dx) & keep_after_shift[dx + 2];
+    }
+
+    Cell cell(int bit) const;
+
+    // The geometry of a width by height board. Built the first time it's
+    // asked for and kept forever. Throws invalid_argument if there can't be
+    // a board that size (2 to 26 by 2 to 99).
+    static const BitboardGeometry &get(int width, int height);
+};
+
+// How many 64-bit words a bitboard of a width by height board needs.
+inline int bitboard_words(int width, int height) {
+    return (width * height + 63) / 64;
+}
+
+// Adds the moves of every piece of the current team to moves. Gives exactly
+// the same moves (maybe in a different order) as asking each piece for its
+// moves.
+void get_bitboard_moves(const Board &board, MoveList &moves);
+// The same, but only the captures (see ChessPiece::get_captures).
+void get_bitboard_captures(const Board &board, MoveList &moves);
+
+#endif  // _BITBOARD_H_
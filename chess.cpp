@@ -1,104 +1,124 @@
 #include <algorithm>
 #include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
 #include <vector>
 
+#include "background_writer.h"
 #include "chess_board.h"
 #include "chess_pieces.h"
 #include "chess_player.h"
+#include "game_record.h"
+#include "opening_book.h"
+#include "tournament.h"
 
 using namespace std;
 
-#include <fstream>
-ofstream out("out.txt");
-
-void play_chess_one_turn(Board &board, Player &player) {
-    out << board << endl;
-    out << player.name() << "'s turn." << endl;
-    vector<Move> moves = board.get_moves();
-    Move move;
-    while (true) {
-        move = player.get_move(board, moves);
-        if (find(moves.begin(), moves.end(), move) != moves.end()) {
-            break;
+int main(int argc, const char *argv[]) {
+    // usage: chess [options] [number of games] [number of threads]
+    //   --record FILE       write every game to FILE as a game record (see
+    //                       game_record.h, and replay to read them)
+    //   --log FILE          write every game to FILE as text...
+    //   --log-level LEVEL   ...with this much of it: results (the default),
+    //                       moves or boards
+    //   --book FILE         have the AI play the moves in the opening book FILE
+    //                       (see opening_book.h, and make_book to make one)
+    const char *record_file_name = nullptr, *log_file_name = nullptr, *book_file_name = nullptr;
+    LogLevel log_level = LOG_RESULTS;
+    vector<const char *> args;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_file_name = argv[++i];
+        } else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            log_file_name = argv[++i];
+        } else if (strcmp(argv[i], "--book") == 0 && i + 1 < argc) {
+            book_file_name = argv[++i];
+        } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            string level = argv[++i];
+            if (level == "results") {
+                log_level = LOG_RESULTS;
+            } else if (level == "moves") {
+                log_level = LOG_MOVES;
+            } else if (level == "boards") {
+                log_level = LOG_BOARDS;
+            } else {
+                cerr << "--log-level must be results, moves or boards" << endl;
+                return 1;
+            }
+        } else {
+            args.push_back(argv[i]);
         }
     }
-    out << player.name() << " chose to move " << board[move.from]
-        << " from " << move.from << " to " << move.to << " ("
-        << board[move.to] << ")\n\n";
-    board.make_move(move);
-}
-
-Team play_one_chess_game(Player &white_player, Player &black_player) {
-    Board board;
-    vector<Move> moves;
-    while (true) {
-        play_chess_one_turn(board, white_player);
-        if (board.winner() != NONE) {
-            break;
-        }
-        play_chess_one_turn(board, black_player);
-        if (board.winner() != NONE) {
-            break;
+    uint64_t num_games = args.size() > 0 ? strtoull(args[0], nullptr, 10) : 1000;
+    int num_threads = args.size() > 1 ? atoi(args[1]) : thread::hardware_concurrency();
+
+    // The games are turned into bytes by the threads that played them, and
+    // written to the files in the background.
+    unique_ptr<BackgroundWriter> record_file, log_file;
+    GameRecorder record_game;
+    if (record_file_name != nullptr || log_file_name != nullptr) {
+        try {
+            if (record_file_name != nullptr) {
+                record_file.reset(new BackgroundWriter(record_file_name));
+                ostringstream header;
+                write_game_record_header(header);
+                record_file->write(header.str());
+            }
+            if (log_file_name != nullptr) {
+                log_file.reset(new BackgroundWriter(log_file_name));
+            }
+        } catch (const runtime_error &e) {
+            cerr << e.what() << endl;
+            return 1;
         }
+        record_game = [&](const GameRecord &record) {
+            if (record_file) {
+                ostringstream bytes;
+                write_game_record(bytes, record);
+                record_file->write(bytes.str());
+            }
+            if (log_file) {
+                ostringstream text;
+                write_game_text(text, record, log_level);
+                log_file->write(text.str());
+            }
+        };
     }
-    Team winner = board.winner();
-    out << team_name(winner) << " won!\n";
-    return winner;
-}
-
-int main(int argc, const char *argv[]) {
-    // HumanPlayer white_player(WHITE);
-    // CapturePlayer white_player(WHITE);
-    // CheckMateCapturePlayer black_player(BLACK);
-
-    // map<int, long> win_counts = {{0, 0}, {1, 0}, {2, 0}};
-    // for (int i = 0; i < 100000; i++) {
-    //     ++win_counts[play_one_chess_game(white_player, black_player)];
-    // }
-    // out << "NONE won " << win_counts[0] << endl;
-    // out << "BLACK won " << win_counts[1] << endl;
-    // out << "WHITE won " << win_counts[2] << endl;
 
-    // Board b(10, 10);
-    // CapturePlayer white_player(WHITE);
-    // CapturePlayer black_player(BLACK);
-
-    // play_chess_one_turn(b, white_player);
-
-    // ofstream out("./out.txt");
-    // out << b;
-
-    // Board c(4, 99);
-    // play_chess_one_turn(c, white_player);
-    // out << c;
-    // out.close();
-
-    // ifstream in("./out.txt");
-    // Board b1;
-    // in >> b1;
-    // out << b1 << endl;
-
-    // Board b2;
-    // in >> b2;
-    // out << b2 << endl;
-
-    map<int, int> win_counts = {{1, 0},
-                                {2, 0}};
-    AIPlayer white_player(WHITE);
-    CheckMateCapturePlayer black_player(BLACK);
-    for (int i = 0; i < 1000; ++i) {
-        ++win_counts[play_one_chess_game(white_player, black_player)];
-
-        out << "\n\n----------Next Game----------\n\n";
-
-        if (i % 100 == 0 && i!= 0) {
-            cout << "out of 100, WHITE WON " << win_counts[WHITE] << " and BLACK WON " << win_counts[BLACK] << endl;
-            win_counts[WHITE] = 0;
-            win_counts[BLACK] = 0;
+    // shared by every thread's AI
+    unique_ptr<OpeningBook> book;
+    if (book_file_name != nullptr) {
+        try {
+            book.reset(new OpeningBook(book_file_name));
+        } catch (exception &e) {
+            cerr << e.what() << endl;
+            return 1;
         }
     }
 
+    Tournament tournament(
+        [&](Team team, unsigned) -> unique_ptr<Player> {
+            AIPlayer *player = new AIPlayer(team);
+            player->use_opening_book(book.get());
+            return unique_ptr<Player>(player);
+        },
+        [](Team team, unsigned seed) -> unique_ptr<Player> { return unique_ptr<Player>(new CheckMateCapturePlayer(team, seed)); },
+        num_threads, chrono::system_clock::now().time_since_epoch().count(), 1000, record_game);
+
+    GameCounts last_report;
+    tournament.run(num_games, 100, [&](const GameCounts &counts) {
+        cout << "out of " << counts.games() - last_report.games()
+             << ", WHITE WON " << counts.white_wins - last_report.white_wins
+             << " and BLACK WON " << counts.black_wins - last_report.black_wins
+             << " (" << counts.draws - last_report.draws << " draws)" << endl;
+        last_report = counts;
+    });
+
     return 0;
 }
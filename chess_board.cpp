@@ -1,13 +1,17 @@
 #include "chess_board.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iomanip>
 #include <iostream>
 #include <map>
 #include <sstream>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
+#include "attack_tables.h"
+#include "bitboard.h"
 #include "chess_pieces.h"
 #include "utf8_codepoint.h"
 
@@ -17,9 +21,11 @@ using std::endl;
 using std::istream;
 using std::map;
 using std::ostream;
+using std::logic_error;
 using std::out_of_range;
 using std::setw;
 using std::stringstream;
+using std::to_string;
 using std::vector;
 
 // https://en.cppreference.com/w/cpp/error/assert
@@ -76,83 +82,283 @@ istream &operator>>(istream &is, Move &move) {
     return is >> move.from >> move.to;
 }
 
-Board::Board(size_t width, size_t height) : width(width), height(height) {
+ostream &operator<<(ostream &os, PackedMove move) {
+    return os << Move(move);
+}
+
+MoveList &MoveList::operator=(const MoveList &other) {
+    if (this != &other) {
+        count = 0;
+        while (capacity < other.count) {
+            grow();
+        }
+        std::copy(other.begin(), other.end(), moves);
+        count = other.count;
+    }
+    return *this;
+}
+
+void MoveList::grow() {
+    vector<PackedMove> bigger(capacity * 2);
+    std::copy(begin(), end(), bigger.begin());
+    heap_moves.swap(bigger);
+    moves = heap_moves.data();
+    capacity *= 2;
+}
+
+LegalMoves::LegalMoves(const MoveList &moves) : moves(moves), slot_mask(STACK_SLOTS - 1), slot_shift(32) {
+    uint32_t num_slots = STACK_SLOTS;
+    while (num_slots < 2 * moves.size()) {
+        num_slots *= 2;
+    }
+    for (uint32_t n = num_slots; n > 1; n /= 2) {
+        --slot_shift;
+    }
+    slot_mask = num_slots - 1;
+
+    uint32_t *slots = stack_slots;
+    if (num_slots > STACK_SLOTS) {
+        heap_slots.resize(num_slots);
+        slots = heap_slots.data();
+    }
+    std::fill(slots, slots + num_slots, EMPTY_SLOT);
+    for (PackedMove move : moves) {
+        uint32_t squares = move.raw() & PackedMove::SQUARES;
+        uint32_t slot = slot_of(squares);
+        while (slots[slot] != EMPTY_SLOT && slots[slot] != squares) {
+            slot = (slot + 1) & slot_mask;
+        }
+        slots[slot] = squares;
+    }
+}
+
+// The Zobrist key of each thing that can be on (or about) the board. A table
+// of keys for every piece code on every square of the biggest board would
+// take up 5MB, so instead each key is made by scrambling what it's the key
+// for (with splitmix64, see https://prng.di.unimi.it/splitmix64.c).
+static uint64_t zobrist_scramble(uint64_t x) {
+    x += 0x9e3779b97f4a7c15;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+}
+
+// the key of the piece with code on square (y * width + x)
+static uint64_t zobrist_piece_key(uint8_t code, int square) {
+    return zobrist_scramble(static_cast<uint64_t>(code) << 32 | static_cast<uint32_t>(square));
+}
+
+static uint64_t zobrist_size_key(size_t width, size_t height) {
+    return zobrist_scramble(uint64_t(1) << 48 | width << 8 | height);
+}
+
+static uint64_t zobrist_turn_key(Team team) {
+    return zobrist_scramble(uint64_t(2) << 48 | team);
+}
+
+Board::Board(size_t width, size_t height) : width(width), height(height), current_teams_turn(WHITE), value_by_type{} {
     assertm(width >= 2 && width <= 26, "width must be between 2 and 26 (inclusive)");
     assertm(height >= 2 && height <= 99, "height must be between 2 and 99 (inclusive)");
     reset_board();
+    set_piece_values(PieceValues());
 }
 
 void Board::resize_board() {
-    board.clear();
+    stride = width + 2 * BORDER;
+    squares.assign((height + 2 * BORDER) * stride, ChessPiece::OFF_BOARD);
 
     for (size_t y = 0; y < height; ++y) {
-        board.push_back({});  // push an empty vector
         for (size_t x = 0; x < width; ++x) {
-            board[y].push_back(&EMPTY_SPACE);
+            squares[square_index(Cell(x, y))] = ChessPiece::EMPTY_CODE;
         }
     }
+
+    undo.changes.clear();
+    undo.history.clear();
+    recording_changes = false;
+    num_white_kings = num_black_kings = 0;
+    material_by_team[NONE] = material_by_team[BLACK] = material_by_team[WHITE] = 0;
+    // empty squares don't count towards the key
+    zobrist_key = zobrist_size_key(width, height) ^ zobrist_turn_key(current_teams_turn);
+
+    attack_tables = &AttackTables::get(width, height);
+
+    words_per_bitboard = bitboard_words(width, height);
+    bitboards.assign((NUM_PIECE_TYPES + 3) * words_per_bitboard, 0);
+    for (size_t bit = 0; bit < width * height; ++bit) {
+        set_bit(bitboards[EMPTY * words_per_bitboard + bit / 64], bit % 64);
+        set_bit(bitboards[(NUM_PIECE_TYPES + NONE) * words_per_bitboard + bit / 64], bit % 64);
+    }
+}
+
+void Board::set_square(Cell cell, uint8_t code) {
+    uint8_t &square = squares[square_index(cell)];
+    if (recording_changes) {
+        undo.changes.push_back({static_cast<uint8_t>(cell.x), static_cast<uint8_t>(cell.y), square});
+    }
+    // the bit's word in the first bitboard
+    uint64_t *words = &bitboards[(cell.y * width + cell.x) / 64];
+    int bit = (cell.y * width + cell.x) % 64;
+    clear_bit(words[ChessPiece::type_by_code[square] * words_per_bitboard], bit);
+    clear_bit(words[(NUM_PIECE_TYPES + ChessPiece::team_by_code[square]) * words_per_bitboard], bit);
+    set_bit(words[ChessPiece::type_by_code[code] * words_per_bitboard], bit);
+    set_bit(words[(NUM_PIECE_TYPES + ChessPiece::team_by_code[code]) * words_per_bitboard], bit);
+    num_white_kings += (code == WHITE_KING.code) - (square == WHITE_KING.code);
+    num_black_kings += (code == BLACK_KING.code) - (square == BLACK_KING.code);
+    material_by_team[ChessPiece::team_by_code[square]] -= value_by_type[ChessPiece::type_by_code[square]];
+    material_by_team[ChessPiece::team_by_code[code]] += value_by_type[ChessPiece::type_by_code[code]];
+    if (square != ChessPiece::EMPTY_CODE) {
+        zobrist_key ^= zobrist_piece_key(square, cell.y * width + cell.x);
+    }
+    if (code != ChessPiece::EMPTY_CODE) {
+        zobrist_key ^= zobrist_piece_key(code, cell.y * width + cell.x);
+    }
+    square = code;
+}
+
+void Board::set_turn(Team team) {
+    zobrist_key ^= zobrist_turn_key(current_teams_turn) ^ zobrist_turn_key(team);
+    current_teams_turn = team;
+}
+
+int Board::piece_value(const ChessPiece &piece) const {
+    return value_by_type[ChessPiece::type_by_code[piece.code]];
+}
+
+void Board::set_piece_values(const PieceValues &values) {
+    value_by_type[EMPTY] = 0;
+    value_by_type[KING] = values.king;
+    value_by_type[QUEEN] = values.queen;
+    value_by_type[BISHOP] = values.bishop;
+    value_by_type[KNIGHT] = values.knight;
+    value_by_type[ROOK] = values.rook;
+    value_by_type[PAWN] = values.pawn;
+    value_by_type[CANNON] = values.cannon;
+    value_by_type[BOMB_TOWER] = values.bomb_tower;
+    value_by_type[CUSTOM] = values.custom;
+
+    material_by_team[NONE] = material_by_team[BLACK] = material_by_team[WHITE] = 0;
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < width; ++x) {
+            uint8_t code = squares[square_index(Cell(x, y))];
+            material_by_team[ChessPiece::team_by_code[code]] += value_by_type[ChessPiece::type_by_code[code]];
+        }
+    }
+}
+
+void Board::set_piece(Cell cell, const ChessPiece &piece) {
+    if (!contains(cell)) {
+        stringstream err_msg;
+        err_msg << "Board::set_piece was given a cell that is not on the board: " << cell;
+        throw out_of_range(err_msg.str());
+    }
+    undo.changes.clear();
+    undo.history.clear();
+    set_square(cell, piece.code);
 }
 
 const ChessPiece &Board::operator[](Cell cell) const {
-    return *board[cell.y][cell.x];
+    return *ChessPiece::piece_by_code[squares[square_index(cell)]];
 }
 
 void Board::reset_board() {
     resize_board();
 
-    if (board.size() >= 4) {
+    if (height >= 4) {
         for (size_t x = 0; x < width; ++x) {
-            board[1][x] = &WHITE_PAWN;
-            board[board.size() - 2][x] = &BLACK_PAWN;
+            set_square(Cell(x, 1), WHITE_PAWN.code);
+            set_square(Cell(x, height - 2), BLACK_PAWN.code);
         }
     }
 
     // important pieces first
-    board[0][board[0].size() / 2] = &WHITE_KING;
-    board[board.size() - 1][board[0].size() / 2] = &BLACK_KING;
-    board[0][board[0].size() / 2 - 1] = &WHITE_QUEEN;
-    board[board.size() - 1][board[0].size() / 2 - 1] = &BLACK_QUEEN;
+    set_square(Cell(width / 2, 0), WHITE_KING.code);
+    set_square(Cell(width / 2, height - 1), BLACK_KING.code);
+    set_square(Cell(width / 2 - 1, 0), WHITE_QUEEN.code);
+    set_square(Cell(width / 2 - 1, height - 1), BLACK_QUEEN.code);
 
     // other pieces, if have space
     vector<vector<const ChessPiece *>> importances = {{&WHITE_BISHOP, &BLACK_BISHOP}, {&WHITE_KNIGHT, &BLACK_KNIGHT}, {&WHITE_ROOK, &BLACK_ROOK}};
     for (size_t i = 0; i < importances.size(); ++i) {
-        size_t xpos1 = board[0].size() / 2 + i + 1;
-        if (xpos1 >= board[0].size()) {
+        size_t xpos1 = width / 2 + i + 1;
+        if (xpos1 >= width) {
             break;
         }
-        board[0][xpos1] = importances[i][0];
-        board[board.size() - 1][xpos1] = importances[i][1];
+        set_square(Cell(xpos1, 0), importances[i][0]->code);
+        set_square(Cell(xpos1, height - 1), importances[i][1]->code);
 
-        int xpos2 = board[0].size() / 2 - 1 - i - 1;
+        int xpos2 = width / 2 - 1 - i - 1;
         if (xpos2 < 0) {
             break;
         }
-        board[0][xpos2] = importances[i][0];
-        board[board.size() - 1][xpos2] = importances[i][1];
+        set_square(Cell(xpos2, 0), importances[i][0]->code);
+        set_square(Cell(xpos2, height - 1), importances[i][1]->code);
     }
 
-    current_teams_turn = WHITE;
+    set_turn(WHITE);
 }
 
-vector<Move> Board::get_moves() const {
-    vector<Move> moves;
-    for (size_t y = 0; y < height; ++y) {
-        for (size_t x = 0; x < width; ++x) {
-            if (board[y][x]->team == current_teams_turn) {
-                board[y][x]->get_moves(*this, Cell(x, y), moves);
-            }
-        }
-    }
-    for (Move move : moves) {
-        if (!contains(move.to) || !contains(move.from)) {
+// Custom pieces can come up with any move, so make sure they stayed on board.
+static void check_moves_are_on_board(const Board &board, const MoveList &moves, const char *function_name) {
+    for (PackedMove move : moves) {
+        if (!board.contains(move.to()) || !board.contains(move.from())) {
             stringstream err_msg;
-            err_msg << "Board::get_moves got a move that moves to or from a cell that is not on the board: " << move;
+            err_msg << function_name << " got a move that moves to or from a cell that is not on the board: " << move;
             throw out_of_range(err_msg.str());
         }
     }
+}
+
+MoveList Board::get_moves() const {
+    MoveList moves;
+    get_bitboard_moves(*this, moves);
+    check_moves_are_on_board(*this, moves, "Board::get_moves");
+    return moves;
+}
+
+MoveList Board::get_captures() const {
+    MoveList moves;
+    get_bitboard_captures(*this, moves);
+    check_moves_are_on_board(*this, moves, "Board::get_captures");
     return moves;
 }
 
+bool Board::captures_king(PackedMove move) const {
+    const ChessPiece &piece = (*this)[move.from()];
+    auto is_enemy_king = [&](Cell cell) {
+        uint8_t code = squares[square_index(cell)];
+        return (code == WHITE_KING.code || code == BLACK_KING.code) && piece.is_opposite_team(code);
+    };
+    if (move.is_capture()) {
+        return is_enemy_king(move.to());
+    }
+    if (move.is_explosion() && piece.type == BOMB_TOWER) {
+        // every square the explosion reaches (see make_explosion_move); the
+        // frame around the board is wide enough that none of them need checking
+        for (int dy = -2; dy <= 2; ++dy) {
+            for (int dx = -2; dx <= 2; ++dx) {
+                if (is_enemy_king(Cell(move.from().x + dx, move.from().y + dy))) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+bool Board::can_capture_king() const {
+    for (PackedMove move : get_captures()) {
+        if (captures_king(move)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+LegalMoves Board::get_legal_moves() const {
+    return LegalMoves(get_moves());
+}
+
 // This function represents how most classical chess ALL_CHESS_PIECES would move.
 // This also allows us to add support for more complex "moves", like a pawn
 // getting to the end of the board and turning into a queen or some other type
@@ -160,9 +366,9 @@ vector<Move> Board::get_moves() const {
 // If we allow the chess piece that's moving to define the move, then we can
 // add really interesting custom ALL_CHESS_PIECES that are nothing like normal ALL_CHESS_PIECES!
 void Board::make_classical_chess_move(Move move) {
-    board[move.to.y][move.to.x] = board[move.from.y][move.from.x];
-    board[move.from.y][move.from.x] = &EMPTY_SPACE;
-    current_teams_turn = current_teams_turn == WHITE ? BLACK : WHITE;
+    set_square(move.to, squares[square_index(move.from)]);
+    set_square(move.from, ChessPiece::EMPTY_CODE);
+    set_turn(current_teams_turn == WHITE ? BLACK : WHITE);
 }
 
 void Board::make_move(Move move) {
@@ -171,7 +377,39 @@ void Board::make_move(Move move) {
         err_msg << "Board::make_move called with a move that moves to or from a cell that is not on the board: " << move;
         throw out_of_range(err_msg.str());
     }
-    board[move.from.y][move.from.x]->make_move(*this, move);
+    undo.history.push_back({static_cast<uint32_t>(undo.changes.size()), current_teams_turn});
+    recording_changes = true;
+    make_piece_move(*this, move);
+    recording_changes = false;
+}
+
+void Board::make_explosion_move(Cell center, int radius) {
+    const ChessPiece &exploding = (*this)[center];
+    for (int y = center.y - radius; y <= center.y + radius; ++y) {
+        for (int x = center.x - radius; x <= center.x + radius; ++x) {
+            Cell target(x, y);
+            if (contains(target) && exploding.is_opposite_team((*this)[target])) {
+                set_square(target, ChessPiece::EMPTY_CODE);
+            }
+        }
+    }
+    set_square(center, ChessPiece::EMPTY_CODE);
+    set_turn(current_teams_turn == WHITE ? BLACK : WHITE);
+}
+
+void Board::unmake_move() {
+    if (undo.history.empty()) {
+        throw logic_error("Board::unmake_move called without a move to take back");
+    }
+    UndoRecord record = undo.history.back();
+    undo.history.pop_back();
+    // put the squares back in the opposite order they were changed in
+    while (undo.changes.size() > record.first_change) {
+        SquareChange change = undo.changes.back();
+        undo.changes.pop_back();
+        set_square(Cell(change.x, change.y), change.code);
+    }
+    set_turn(record.turn);
 }
 
 bool Board::contains(Cell cell) const {
@@ -179,45 +417,62 @@ bool Board::contains(Cell cell) const {
 }
 
 Team Board::winner() const {
-    bool found_white_king = false, found_black_king = false;
-    for (size_t y = 0; y < height; ++y) {
-        for (size_t x = 0; x < width; ++x) {
-            if (board[y][x] == &WHITE_KING) {
-                found_white_king = true;
-            } else if (board[y][x] == &BLACK_KING) {
-                found_black_king = true;
-            }
-        }
-    }
-    if (!found_white_king) {
+    if (num_white_kings == 0) {
         return BLACK;
     }
-    if (!found_black_king) {
+    if (num_black_kings == 0) {
         return WHITE;
     }
     return NONE;
 }
 
-ostream &operator<<(ostream &os, const Board &board) {
-    os << "   ";
-    for (size_t i = 0; i < board.width; ++i) {
-        os << static_cast<char>('a' + i);
+bool Board::operator==(const Board &other) const {
+    // different hashes means different boards, which is the usual case
+    return zobrist_key == other.zobrist_key && width == other.width && height == other.height &&
+           current_teams_turn == other.current_teams_turn && squares == other.squares;
+}
+
+bool Board::operator!=(const Board &other) const {
+    return !(*this == other);
+}
+
+// the letters of the files, as written above and below the board
+static void write_files(size_t width, string &text) {
+    text += "   ";
+    for (size_t i = 0; i < width; ++i) {
+        text += static_cast<char>('a' + i);
     }
-    os << "\n";
+    text += '\n';
+}
 
-    for (int y = board.height - 1; y >= 0; --y) {
-        os << ((y + 1) / 10 > 0 ? "" : " ") << (y + 1) << ' ';
-        for (int x = 0; x < static_cast<int>(board.width); ++x) {
-            os << board[Cell(x, y)];
+void write_board(const Board &board, string &text) {
+    int width = board.get_width(), height = board.get_height();
+    write_files(width, text);
+    for (int y = height - 1; y >= 0; --y) {
+        string rank = to_string(y + 1);
+        if (rank.size() < 2) {
+            text += ' ';
         }
-        os << ' ' << (y + 1) << endl;
-    }
-    os << "   ";
-    for (size_t i = 0; i < board.width; ++i) {
-        os << static_cast<char>('a' + i);
+        text += rank;
+        text += ' ';
+        int index = board.square_index(Cell(0, y));
+        for (int x = 0; x < width; ++x) {
+            const ChessPiece::UTF8Bytes &utf8 = ChessPiece::utf8_by_code[board.code_at(index + x)];
+            text.append(utf8.bytes, utf8.size);
+        }
+        text += ' ';
+        text += rank;
+        text += '\n';
     }
-    os << "\n";
-    return os;
+    write_files(width, text);
+}
+
+ostream &operator<<(ostream &os, const Board &board) {
+    // kept from one board to the next, so that writing one doesn't allocate
+    thread_local string text;
+    text.clear();
+    write_board(board, text);
+    return os.write(text.data(), text.size());
 }
 
 istream &operator>>(istream &is, Board &board) {
@@ -238,6 +493,10 @@ istream &operator>>(istream &is, Board &board) {
     // get num cols
     is >> num_rows;
     is.get(c);
+    if (num_cols < 2 || num_cols > 26 || num_rows < 2 || num_rows > 99) {
+        is.setstate(std::ios::failbit);
+        return is;
+    }
 
     // set the board's stuff
     board.width = num_cols;
@@ -250,7 +509,7 @@ istream &operator>>(istream &is, Board &board) {
         for (size_t col = 0; col < num_cols; ++col) {
             UTF8CodePoint temp;
             is >> temp;
-            board.board[num_rows - row - 1][col] = ALL_CHESS_PIECES.at(temp);
+            board.set_square(Cell(col, num_rows - row - 1), ALL_CHESS_PIECES.at(temp)->code);
         }
         // get the whitespace, row number, newline, whitespace, row number, whitespace
         for (int i = 0; i < 2; ++i) {
@@ -1,8 +1,12 @@
 #ifndef _CHESS_BOARD_H_
 #define _CHESS_BOARD_H_
 
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include "utf8_codepoint.h"
@@ -10,8 +14,10 @@
 using std::istream;
 using std::map;
 using std::ostream;
+using std::string;
 using std::vector;
 
+class AttackTables;
 class ChessPiece;
 
 enum Team {
@@ -22,6 +28,23 @@ enum Team {
 
 const char* team_name(Team team);
 
+// What kind of piece something is, so the board can generate moves for all
+// the pieces of one kind at once (see bitboard.h). Pieces that don't behave
+// exactly like one of the built-in kinds are CUSTOM.
+enum PieceType {
+    EMPTY,
+    KING,
+    QUEEN,
+    BISHOP,
+    KNIGHT,
+    ROOK,
+    PAWN,
+    CANNON,
+    BOMB_TOWER,
+    CUSTOM,
+    NUM_PIECE_TYPES
+};
+
 // A place on the board
 struct Cell {
     int x;  // file -  1  (so we start at 0 instead of 1)
@@ -48,22 +71,331 @@ struct Move {
 ostream& operator<<(ostream& os, const Move& move);
 istream& operator>>(istream& is, Move& move);
 
+// A Move packed into 32 bits, plus flags the move generator fills in so that
+// nobody has to look at the board to find out what kind of move it is.
+// 16 bits would only fit boards of up to 256 squares: the biggest board
+// (26 x 99) has 2574 squares, so each square takes 12 bits (a 5-bit file and
+// a 7-bit rank) and a move 24. The flags go in the bits above those.
+// Converts to and from Move, which is what gets read, written and played.
+class PackedMove {
+    uint32_t bits;
+
+    static uint32_t pack_cell(Cell cell) {
+        return (cell.x & 31) | (cell.y & 127) << 5;
+    }
+    static Cell unpack_cell(uint32_t bits) {
+        return Cell(bits & 31, bits >> 5 & 127);
+    }
+
+   public:
+    // the bits that say which squares the move is from and to
+    static constexpr uint32_t SQUARES = (1 << 24) - 1;
+    // There's a piece of the other team on the square the move goes to.
+    static constexpr uint32_t CAPTURE = 1 << 24;
+    // The piece stays where it is and explodes (a bomb tower).
+    static constexpr uint32_t EXPLOSION = 1 << 25;
+
+    PackedMove() = default;
+    PackedMove(Cell from, Cell to, uint32_t flags = 0) : bits(pack_cell(from) | pack_cell(to) << 12 | flags) {}
+    PackedMove(Move move) : PackedMove(move.from, move.to) {}
+    // A move from the bits another PackedMove's raw() gave.
+    explicit PackedMove(uint32_t raw) : bits(raw) {}
+
+    Cell from() const {
+        return unpack_cell(bits);
+    }
+    Cell to() const {
+        return unpack_cell(bits >> 12);
+    }
+    bool is_capture() const {
+        return bits & CAPTURE;
+    }
+    bool is_explosion() const {
+        return bits & EXPLOSION;
+    }
+    uint32_t raw() const {
+        return bits;
+    }
+    operator Move() const {
+        return Move(from(), to());
+    }
+
+    // Moves are the same if they go from and to the same squares. The flags
+    // only describe the move, so they don't count.
+    bool operator==(PackedMove other) const {
+        return ((bits ^ other.bits) & SQUARES) == 0;
+    }
+    bool operator!=(PackedMove other) const {
+        return !(*this == other);
+    }
+};
+
+ostream& operator<<(ostream& os, PackedMove move);
+
+// The list of moves the move generator fills in. Room for STACK_CAPACITY
+// moves is part of the list itself, so a list that's a local variable never
+// touches the heap. Only a position with more moves than that (which takes a
+// big board with lots of pieces on it) moves the list onto the heap.
+class MoveList {
+   public:
+    static constexpr size_t STACK_CAPACITY = 256;
+
+    MoveList() : moves(stack_moves), count(0), capacity(STACK_CAPACITY) {}
+    MoveList(const MoveList& other) : MoveList() {
+        *this = other;
+    }
+    MoveList& operator=(const MoveList& other);
+
+    void push_back(PackedMove move) {
+        if (count == capacity) {
+            grow();
+        }
+        moves[count++] = move;
+    }
+    void emplace_back(Cell from, Cell to, uint32_t flags = 0) {
+        push_back(PackedMove(from, to, flags));
+    }
+    void clear() {
+        count = 0;
+    }
+    // Drops every move from new_size onwards.
+    void truncate(size_t new_size) {
+        count = new_size < count ? new_size : count;
+    }
+
+    size_t size() const {
+        return count;
+    }
+    bool empty() const {
+        return count == 0;
+    }
+    PackedMove& operator[](size_t i) {
+        return moves[i];
+    }
+    PackedMove operator[](size_t i) const {
+        return moves[i];
+    }
+    PackedMove* begin() {
+        return moves;
+    }
+    PackedMove* end() {
+        return moves + count;
+    }
+    const PackedMove* begin() const {
+        return moves;
+    }
+    const PackedMove* end() const {
+        return moves + count;
+    }
+
+   private:
+    // Moves everything to the heap, with twice the room.
+    void grow();
+
+    PackedMove* moves;  // stack_moves, or heap_moves once it's grown
+    size_t count, capacity;
+    vector<PackedMove> heap_moves;
+    PackedMove stack_moves[STACK_CAPACITY];
+};
+
+// A position's moves (see Board::get_legal_moves) along with a hash set of
+// them, so that checking a move someone picked doesn't have to look through
+// all of them. Like MoveList, the set only goes on the heap when there are
+// more than MoveList::STACK_CAPACITY moves.
+class LegalMoves {
+   public:
+    explicit LegalMoves(const MoveList& moves);
+
+    const MoveList& get_moves() const {
+        return moves;
+    }
+    // Whether move is one of the moves, in constant time.
+    bool is_legal(Move move) const {
+        PackedMove packed(move);
+        if (Move(packed) != move) {
+            return false;  // off every board, so it didn't fit in a PackedMove
+        }
+        const uint32_t* slots = get_slots();
+        for (uint32_t slot = slot_of(packed.raw());; slot = (slot + 1) & slot_mask) {
+            if (slots[slot] == packed.raw()) {
+                return true;
+            }
+            if (slots[slot] == EMPTY_SLOT) {
+                return false;
+            }
+        }
+    }
+
+   private:
+    // Moves in the set only have their SQUARES bits set, so they're never this.
+    static constexpr uint32_t EMPTY_SLOT = ~uint32_t(0);
+    static constexpr uint32_t STACK_SLOTS = 2 * MoveList::STACK_CAPACITY;
+
+    // Fibonacci hashing: the top bits of squares times 2^32 / golden ratio.
+    uint32_t slot_of(uint32_t squares) const {
+        return squares * 2654435769u >> slot_shift;
+    }
+    const uint32_t* get_slots() const {
+        return heap_slots.empty() ? stack_slots : heap_slots.data();
+    }
+
+    MoveList moves;
+    // There are always at least twice as many slots as moves, and the number
+    // of slots is a power of 2 (slot_mask + 1, which is 2^(32 - slot_shift)).
+    uint32_t slot_mask, slot_shift;
+    vector<uint32_t> heap_slots;
+    uint32_t stack_slots[STACK_SLOTS];
+};
+
+// What each kind of piece is worth, for Board::material. Kings are worth a
+// lot so that losing one (and the game) is worse than losing anything else.
+// The kinds that aren't in normal chess are worth 5 unless you say otherwise,
+// and all custom pieces are worth the same.
+struct PieceValues {
+    int king = 100;
+    int queen = 9;
+    int bishop = 3;
+    int knight = 3;
+    int rook = 5;
+    int pawn = 1;
+    int cannon = 5;
+    int bomb_tower = 5;
+    int custom = 5;
+};
+
 class Board {
     size_t width, height;
-    vector<vector<const ChessPiece*>> board;
+    // The pieces are stored as their 1-byte ChessPiece::code in one contiguous
+    // row-major block, so copying a board is a single allocation + memcpy.
+    // The playable area is framed by BORDER rows/columns of
+    // ChessPiece::OFF_BOARD on every side, which lets pieces look past the
+    // edge (or walk a ray until it hits the frame) without calling contains().
+    size_t stride;
+    vector<uint8_t> squares;
+    // Bitboards (see bitboard.h) of the same pieces: one for each PieceType
+    // followed by one for each Team, words_per_bitboard words each. Updated
+    // on every square write.
+    int words_per_bitboard;
+    vector<uint64_t> bitboards;
+    // Shared with every other board of the same size.
+    const AttackTables* attack_tables;
     Team current_teams_turn;
+
+    // What a square held before make_move changed it.
+    struct SquareChange {
+        uint8_t x, y;
+        uint8_t code;
+    };
+    // What unmake_move needs to undo one make_move: the changes from
+    // first_change onwards, and whose turn it was.
+    struct UndoRecord {
+        uint32_t first_change;
+        Team turn;
+    };
+    // Copying a board doesn't copy these (a copy starts with no moves to take
+    // back), so that a copy costs the same however long the game has gone
+    // on. Assigning to a board keeps its memory for them.
+    struct UndoLog {
+        vector<SquareChange> changes;
+        vector<UndoRecord> history;
+
+        UndoLog() = default;
+        UndoLog(const UndoLog&) {}
+        UndoLog(UndoLog&&) = default;
+        UndoLog& operator=(const UndoLog&) {
+            changes.clear();
+            history.clear();
+            return *this;
+        }
+        UndoLog& operator=(UndoLog&&) = default;
+    };
+    UndoLog undo;
+    // Only set while make_move is running, so that set_square knows to
+    // remember what it overwrites.
+    bool recording_changes;
+    // How many WHITE_KINGs and BLACK_KINGs are on the board, kept up to date
+    // by set_square so that winner() doesn't have to look for them.
+    int num_white_kings, num_black_kings;
+    // Zobrist hash of the position (see hash()), kept up to date by
+    // set_square and set_turn.
+    uint64_t zobrist_key;
+    // What each PieceType is worth (0 for EMPTY), and the total worth of
+    // each Team's pieces, kept up to date by set_square.
+    int value_by_type[NUM_PIECE_TYPES];
+    int material_by_team[3];
+
     void resize_board();
+    void set_square(Cell cell, uint8_t code);
+    void set_turn(Team team);
 
    public:
+    // Wide enough for the longest jump any piece makes (2 squares).
+    static constexpr int BORDER = 2;
+
     Board(size_t width = 8, size_t height = 8);
 
     const size_t get_width() const;
     const size_t get_height() const;
 
     const ChessPiece& operator[](Cell cell) const;
+    // Index of cell in the flat square array. cell may be up to BORDER
+    // squares off the board, in which case the square holds OFF_BOARD.
+    int square_index(Cell cell) const {
+        return (cell.y + BORDER) * static_cast<int>(stride) + cell.x + BORDER;
+    }
+    // How far apart (in the flat square array) two squares `direction` apart are.
+    int index_offset(Cell direction) const {
+        return direction.y * static_cast<int>(stride) + direction.x;
+    }
+    // The ChessPiece::code of the piece at index (see square_index).
+    uint8_t code_at(int index) const {
+        return squares[index];
+    }
+    // Where pieces can go on a board this size (see attack_tables.h).
+    const AttackTables& get_attack_tables() const {
+        return *attack_tables;
+    }
+    Team get_current_teams_turn() const {
+        return current_teams_turn;
+    }
+    // Makes it team's turn (for example after reading in a board, which
+    // doesn't say whose turn it is).
+    void set_current_teams_turn(Team team) {
+        set_turn(team);
+    }
+    // Puts piece on cell, for setting up a position. Like reading a board
+    // in, this forgets the moves made so far (they can't be taken back).
+    void set_piece(Cell cell, const ChessPiece& piece);
+    // A 64-bit Zobrist hash of the size of the board, every piece on it and
+    // whose turn it is. Boards that are == always have the same hash. It's
+    // updated a square at a time as moves are made, so this is free to call.
+    uint64_t hash() const {
+        return zobrist_key;
+    }
+    // What piece is worth (0 for an empty square).
+    int piece_value(const ChessPiece& piece) const;
+    // The total worth of team's pieces. Like hash(), it's kept up to date as
+    // moves are made, so it's free to call.
+    int material(Team team) const {
+        return material_by_team[team];
+    }
+    // Changes what the pieces are worth (see PieceValues), for this board
+    // and its copies.
+    void set_piece_values(const PieceValues& values);
     // Reset all the pieces on the board (as if you're starting a new game).
     void reset_board();
-    vector<Move> get_moves() const;
+    // Generates the moves with bitboards (see bitboard.h).
+    MoveList get_moves() const;
+    // The same moves, set up for checking whether a move is one of them.
+    LegalMoves get_legal_moves() const;
+    // Only the moves that capture something (see ChessPiece::get_captures).
+    MoveList get_captures() const;
+    // Whether move (one of the current team's moves) takes one of the other
+    // team's kings, by moving onto it or by a bomb tower exploding with it
+    // in range. Either one wins the game.
+    bool captures_king(PackedMove move) const;
+    // Whether any of the current team's moves does.
+    bool can_capture_king() const;
     // This function represents how most classical chess pieces would move.
     // This also allows us to add support for more complex "moves", like a pawn
     // getting to the end of the board and turning into a queen or some other type
@@ -71,15 +403,52 @@ class Board {
     // If we allow the chess piece that's moving to define the move, then we can
     // add really interesting custom pieces that are nothing like normal pieces!
     void make_classical_chess_move(Move move);
-    // Makes a move on the board by calling make_move on the piece at move.from.
+    // Removes the piece at center and every piece on the other team (from
+    // that piece) within radius files and ranks of it, then passes the turn.
+    void make_explosion_move(Cell center, int radius);
+    // Makes a move on the board the way the piece at move.from moves (see
+    // make_piece_move in chess_pieces.h).
     void make_move(Move move);
+    // Takes back the last move made with make_move, putting everything back
+    // exactly the way it was. Throws logic_error if there are no moves left
+    // to take back. Resetting (or reading in) the board forgets all moves,
+    // and a copy of a board starts out with none.
+    void unmake_move();
     // Returns true if cell is on the board
     bool contains(Cell cell) const;
-    // Returns the winner or NONE if there is no winner (yet).
+    // Returns the winner or NONE if there is no winner (yet). Doesn't look at
+    // the squares, so it's as cheap to call on a big board as on a small one.
     Team winner() const;
 
+    // Two boards are equal if they're the same size, have the same pieces in
+    // the same places and it's the same team's turn. The moves that led
+    // there don't matter.
+    bool operator==(const Board& other) const;
+    bool operator!=(const Board& other) const;
+
     friend ostream& operator<<(ostream& os, const Board& board);
+    // Reads a board the way operator<< writes it. If it isn't 2 to 26 squares
+    // wide and 2 to 99 high (or there's no board left to read), this sets
+    // failbit and leaves board alone.
     friend istream& operator>>(istream& is, Board& board);
+    friend void read_position(std::string_view text, Board& board);
+    friend class PositionDatabase;
+    friend void get_bitboard_moves(const Board& board, MoveList& moves);
+    friend void get_bitboard_captures(const Board& board, MoveList& moves);
+};
+
+// Adds board to the end of text the way operator<< writes it (which is
+// with this, so that the whole board goes to the stream in one write).
+void write_board(const Board& board, string& text);
+
+// So that boards can be used as keys in unordered_map/unordered_set.
+namespace std {
+template <>
+struct hash<Board> {
+    size_t operator()(const Board& board) const {
+        return board.hash();
+    }
 };
+}  // namespace std
 
 #endif  // _CHESS_BOARD_H_
@@ -1,11 +1,80 @@
 #include "chess_pieces.h"
 
+#include <stdexcept>
+
+#include "attack_tables.h"
 #include "utf8_codepoint.h"
 
+using std::length_error;
+
+const ChessPiece *ChessPiece::piece_by_code[256] = {};
+Team ChessPiece::team_by_code[256] = {};
+PieceType ChessPiece::type_by_code[256] = {};
+ChessPiece::UTF8Bytes ChessPiece::utf8_by_code[256] = {};
+
+// EMPTY_CODE is reserved for EmptySpace, so the other pieces start at 1.
+// The codes of pieces that have been destroyed are used again first. These
+// are plain arrays and ints so that they're ready before any piece is made,
+// whichever file it's in.
+static int next_piece_code = 1;
+static uint8_t free_piece_codes[256];
+static int num_free_piece_codes = 0;
+
+static uint8_t claim_piece_code() {
+    if (num_free_piece_codes > 0) {
+        return free_piece_codes[--num_free_piece_codes];
+    }
+    if (next_piece_code >= ChessPiece::OFF_BOARD) {
+        throw length_error("ran out of codes for chess pieces");
+    }
+    return next_piece_code++;
+}
+
+ChessPiece::ChessPiece(UTF8CodePoint cp, Team team, PieceType type) : ChessPiece(cp, team, type, claim_piece_code()) {}
+
+ChessPiece::ChessPiece(UTF8CodePoint cp, Team team, PieceType type, uint8_t code) : utf8_codepoint(cp), team(team), type(type), code(code) {
+    piece_by_code[code] = this;
+    team_by_code[code] = team;
+    type_by_code[code] = type;
+    utf8_by_code[code].size = encode_utf8(cp, utf8_by_code[code].bytes);
+}
+
+ChessPiece::~ChessPiece() {
+    piece_by_code[code] = nullptr;
+    team_by_code[code] = NONE;
+    type_by_code[code] = EMPTY;
+    utf8_by_code[code].size = 0;
+    if (code != EMPTY_CODE) {
+        free_piece_codes[num_free_piece_codes++] = code;
+    }
+}
+
+const ChessPiece *ChessPiece::with_code_point(char32_t code_point) {
+    for (int code = EMPTY_CODE; code < OFF_BOARD; ++code) {
+        if (piece_by_code[code] != nullptr && piece_by_code[code]->utf8_codepoint == code_point) {
+            return piece_by_code[code];
+        }
+    }
+    return nullptr;
+}
+
 bool ChessPiece::is_opposite_team(const ChessPiece &other) const {
     return (team == WHITE && other.team == BLACK) || (team == BLACK && other.team == WHITE);
 }
 
+void ChessPiece::get_captures(const Board &board, Cell from, MoveList &moves) const {
+    size_t first_move = moves.size();
+    get_moves(board, from, moves);
+    size_t num_moves = first_move;
+    for (size_t i = first_move; i < moves.size(); ++i) {
+        Cell to = moves[i].to();
+        if (is_opposite_team(board[to]) || to == from) {
+            moves[num_moves++] = moves[i];
+        }
+    }
+    moves.truncate(num_moves);
+}
+
 bool ChessPiece::operator==(const ChessPiece &other) const {
     return utf8_codepoint == other.utf8_codepoint;
 }
@@ -14,27 +83,92 @@ bool ChessPiece::operator!=(const ChessPiece &other) const {
 }
 
 ostream &operator<<(ostream &os, const ChessPiece &p) {
-    return os << p.utf8_codepoint;
+    const ChessPiece::UTF8Bytes &utf8 = ChessPiece::utf8_by_code[p.code];
+    return os.write(utf8.bytes, utf8.size);
 }
 
 void SimpleChessPiece::make_move(Board &board, Move move) const {
     board.make_classical_chess_move(move);
 }
 
-void King::get_moves(const Board &board, Cell from, vector<Move> &moves) const {
-    for (int x = from.x - 1; x < from.x + 2; ++x) {
-        for (int y = from.y - 1; y < from.y + 2; ++y) {
-            Cell to(x, y);
-            if (from != to && board.contains(to) && (board[to] == EMPTY_SPACE || is_opposite_team(board[to]))) {
+// The moves of each built-in kind of piece, for a piece of team on from
+// (only its captures if captures_only, see ChessPiece::get_captures). The
+// pieces' get_moves and get_captures call these, and so do get_piece_moves
+// and get_piece_captures, which pick one with a switch instead of a virtual
+// call.
+
+static bool is_enemy(Team team, uint8_t code) {
+    Team other = ChessPiece::team_by_code[code];
+    return (team == WHITE && other == BLACK) || (team == BLACK && other == WHITE);
+}
+
+// Walks from `from` in each direction until it hits another piece or the
+// edge of the board (the OFF_BOARD frame), like a queen, bishop or rook.
+template <bool captures_only>
+static void get_sliding_moves(Team team, const Board &board, Cell from, const Cell *directions, int num_directions, MoveList &moves) {
+    int from_index = board.square_index(from);
+    for (int i = 0; i < num_directions; ++i) {
+        Cell direction = directions[i];
+        int step = board.index_offset(direction);
+        Cell to = from;
+        for (int index = from_index + step;; index += step) {
+            to.x += direction.x;
+            to.y += direction.y;
+            uint8_t code = board.code_at(index);
+            if (code == ChessPiece::EMPTY_CODE) {
+                if (!captures_only) {
+                    moves.emplace_back(from, to);
+                }
+            } else {
+                if (is_enemy(team, code)) {
+                    moves.emplace_back(from, to, PackedMove::CAPTURE);
+                }
+                break;  // same team or off the board
+            }
+        }
+    }
+}
+
+// Jumps to each of leaper's (precomputed) targets that's empty or has a
+// piece of the other team on it.
+template <bool captures_only>
+static void get_leaper_moves(Team team, Leaper leaper, const Board &board, Cell from, MoveList &moves) {
+    int from_index = board.square_index(from);
+    bool can_explode = false, enemy_in_range = false;
+    for (LeaperTarget target : board.get_attack_tables().leaper_targets(leaper, from)) {
+        uint8_t code = board.code_at(from_index + target.index_offset);
+        Cell to(from.x + target.dx, from.y + target.dy);
+        if (code == ChessPiece::EMPTY_CODE) {
+            if (!captures_only) {
                 moves.emplace_back(from, to);
             }
+        } else if (is_enemy(team, code)) {
+            moves.emplace_back(from, to, PackedMove::CAPTURE);
+            enemy_in_range = true;
+        } else if (target.index_offset == 0) {
+            // only a bomb tower can "jump" to its own square, which is how it explodes
+            if (!captures_only) {
+                moves.emplace_back(from, to, PackedMove::EXPLOSION);
+            }
+            can_explode = true;
         }
     }
+    // Exploding only captures something if there's an enemy in range, which
+    // isn't known until every target has been looked at.
+    if (captures_only && can_explode && enemy_in_range) {
+        moves.emplace_back(from, from, PackedMove::EXPLOSION);
+    }
+}
+
+template <bool captures_only>
+static void get_king_moves(Team team, const Board &board, Cell from, MoveList &moves) {
+    get_leaper_moves<captures_only>(team, KING_LEAPS, board, from, moves);
 }
 
-void Queen::get_moves(const Board &board, Cell from, vector<Move> &moves) const {
+template <bool captures_only>
+static void get_queen_moves(Team team, const Board &board, Cell from, MoveList &moves) {
     // The 8 directions a queen can go...
-    Cell directions[] = {
+    static const Cell directions[] = {
         {-1, 1},
         {0, 1},
         {1, 1},
@@ -44,224 +178,273 @@ void Queen::get_moves(const Board &board, Cell from, vector<Move> &moves) const
         {0, -1},
         {1, -1},
     };
-    for (Cell direction : directions) {
-        for (int steps = 1;; ++steps) {
-            Cell to(from.x + steps * direction.x, from.y + steps * direction.y);
-            if (!board.contains(to)) {
-                break;
-            }
-            const ChessPiece &piece = board[to];
-            if (piece == EMPTY_SPACE) {
-                moves.emplace_back(from, to);
-            } else if (is_opposite_team(piece)) {
-                moves.emplace_back(from, to);
-                break;
-            } else {  // if (team == piece.team)
-                break;
-            }
-        }
-    }
+    get_sliding_moves<captures_only>(team, board, from, directions, 8, moves);
 }
 
-void Bishop::get_moves(const Board &board, Cell from, vector<Move> &moves) const {
+template <bool captures_only>
+static void get_bishop_moves(Team team, const Board &board, Cell from, MoveList &moves) {
     // The 4 directions a bishop can go...
-    Cell directions[] = {
+    static const Cell directions[] = {
         {-1, 1},
         {1, 1},
         {-1, -1},
         {1, -1},
     };
-    for (Cell direction : directions) {
-        for (int steps = 1;; ++steps) {
-            Cell to(from.x + steps * direction.x, from.y + steps * direction.y);
-            if (!board.contains(to)) {
-                break;
-            }
-            const ChessPiece &piece = board[to];
-            if (piece == EMPTY_SPACE) {
-                moves.emplace_back(from, to);
-            } else if (is_opposite_team(piece)) {
-                moves.emplace_back(from, to);
-                break;
-            } else {  // if (team == piece.team)
-                break;
-            }
-        }
-    }
+    get_sliding_moves<captures_only>(team, board, from, directions, 4, moves);
 }
 
-void Knight::get_moves(const Board &board, Cell from, vector<Move> &moves) const {
-    Cell jumps[] = {
-        {-1, 2},
-        {1, 2},
-        {-2, 1},
-        {2, 1},
-        {-2, -1},
-        {2, -1},
-        {-1, -2},
-        {1, -2},
-    };
-    for (Cell jump : jumps) {
-        Cell to(from.x + jump.x, from.y + jump.y);
-        if (board.contains(to)) {
-            const ChessPiece &piece = board[to];
-            if (piece == EMPTY_SPACE || is_opposite_team(piece)) {
-                moves.emplace_back(from, to);
-            }
-        }
-    }
+template <bool captures_only>
+static void get_knight_moves(Team team, const Board &board, Cell from, MoveList &moves) {
+    get_leaper_moves<captures_only>(team, KNIGHT_LEAPS, board, from, moves);
 }
 
-void Rook::get_moves(const Board &board, Cell from, vector<Move> &moves) const {
+template <bool captures_only>
+static void get_rook_moves(Team team, const Board &board, Cell from, MoveList &moves) {
     // The 4 directions a rook can go...
-    Cell directions[] = {
+    static const Cell directions[] = {
         {0, 1},
         {-1, 0},
         {1, 0},
         {0, -1},
     };
-    for (Cell direction : directions) {
-        for (int steps = 1;; ++steps) {
-            Cell to(from.x + steps * direction.x, from.y + steps * direction.y);
-            if (!board.contains(to)) {
-                break;
-            }
-            const ChessPiece &piece = board[to];
-            if (piece == EMPTY_SPACE) {
-                moves.emplace_back(from, to);
-            } else if (is_opposite_team(piece)) {
-                moves.emplace_back(from, to);
-                break;
-            } else {  // if (team == piece.team)
-                break;
-            }
-        }
-    }
+    get_sliding_moves<captures_only>(team, board, from, directions, 4, moves);
 }
 
-void Pawn::get_moves(const Board &board, Cell from, vector<Move> &moves) const {
-    Cell to = Cell(from.x, from.y + y_move_steps);
-    if (board.contains(to) && board[to] == EMPTY_SPACE) {
-        moves.emplace_back(from, to);
+template <bool captures_only>
+static void get_pawn_moves(Team team, int y_move_steps, const Board &board, Cell from, MoveList &moves) {
+    // The frame around the board is only BORDER squares deep, so a custom
+    // pawn that moves further than that has to check it stays on the board.
+    if ((y_move_steps > Board::BORDER || y_move_steps < -Board::BORDER) && !board.contains(Cell(from.x, from.y + y_move_steps))) {
+        return;
+    }
+    int forward_index = board.square_index(Cell(from.x, from.y + y_move_steps));
+    if (!captures_only && board.code_at(forward_index) == ChessPiece::EMPTY_CODE) {
+        moves.emplace_back(from, Cell(from.x, from.y + y_move_steps));
     }
 
-    to = Cell(from.x - 1, from.y + y_move_steps);
-    if (board.contains(to) && is_opposite_team(board[to])) {
-        moves.emplace_back(from, to);
+    if (is_enemy(team, board.code_at(forward_index - 1))) {
+        moves.emplace_back(from, Cell(from.x - 1, from.y + y_move_steps), PackedMove::CAPTURE);
     }
 
-    to = Cell(from.x + 1, from.y + y_move_steps);
-    if (board.contains(to) && is_opposite_team(board[to])) {
-        moves.emplace_back(from, to);
+    if (is_enemy(team, board.code_at(forward_index + 1))) {
+        moves.emplace_back(from, Cell(from.x + 1, from.y + y_move_steps), PackedMove::CAPTURE);
     }
 }
 
-void Cannon::get_moves(const Board &board, Cell from, vector<Move> &moves) const {
+template <bool captures_only>
+static void get_cannon_moves(Team team, const Board &board, Cell from, MoveList &moves) {
     // The cannon can move similar to a rook (in straight lines)
-    Cell directions[] = {
+    static const Cell directions[] = {
         {0, 1},
         {-1, 0},
         {1, 0},
         {0, -1},
     };
-    vector<Cell> potential_jumpable_directions;
+    int from_index = board.square_index(from);
     for (Cell direction : directions) {
-        for (int steps = 1;; ++steps) {
-            Cell to(from.x + steps * direction.x, from.y + steps * direction.y);
-            if (!board.contains(to)) {
-                break;
-            }
-            const ChessPiece &piece = board[to];
-            if (piece == EMPTY_SPACE) {
+        int step = board.index_offset(direction);
+        int index = from_index + step;
+        Cell to(from.x + direction.x, from.y + direction.y);
+        while (board.code_at(index) == ChessPiece::EMPTY_CODE) {
+            if (!captures_only) {
                 moves.emplace_back(from, to);
-            } else {
-                potential_jumpable_directions.push_back(direction);
-                break;
             }
-        }
-    }
-
-    // but can also jump over a piece and hit the next piece in that direction
-    for (Cell direction : potential_jumpable_directions) {
-        Cell to(from.x + direction.x, from.y + direction.y);
-
-        // first, get to the location of the located piece in that direction
-        while (board.contains(to) && board[to] == EMPTY_SPACE) {
             to.x += direction.x;
             to.y += direction.y;
+            index += step;
+        }
+        if (board.code_at(index) == ChessPiece::OFF_BOARD) {
+            continue;
         }
 
-        // then, check to see if there is another piece "behind" that piece that
-        // the cannon can hit
-        to.x += direction.x;
-        to.y += direction.y;
-        while (board.contains(to) && board[to] == EMPTY_SPACE) {
+        // but can also jump over the piece it stopped at and hit the next
+        // piece behind it in that direction, if that's on the opposite team
+        do {
             to.x += direction.x;
             to.y += direction.y;
-        }
-
-        // if the piece "behind" that piece is on opposite team, then the cannon
-        // can hit it
-        if (board.contains(to) && is_opposite_team(board[to])) {
-            moves.emplace_back(from, to);
+            index += step;
+        } while (board.code_at(index) == ChessPiece::EMPTY_CODE);
+        if (is_enemy(team, board.code_at(index))) {
+            moves.emplace_back(from, to, PackedMove::CAPTURE);
         }
     }
 }
 
-void BombTower::get_moves(const Board &board, Cell from, vector<Move> &moves) const {
-    // tower can move anywhere in a 2 by 2 square
-    for (int x = -2; x <= 2; ++x) {
-        for (int y = -2; y <= 2; ++y) {
-            Cell to(from.x + x, from.y + y);
-            if (board.contains(to) && (board[to] == EMPTY_SPACE || is_opposite_team(board[to]) || to == from)) {
-                moves.emplace_back(from, to);
-            }
-        }
-    }
+template <bool captures_only>
+static void get_bomb_tower_moves(Team team, const Board &board, Cell from, MoveList &moves) {
+    // tower can move anywhere in a 2 by 2 square (or explode where it is)
+    get_leaper_moves<captures_only>(team, BOMB_TOWER_LEAPS, board, from, moves);
 }
 
-void BombTower::make_move(Board &board, Move move) const {
+static void make_bomb_tower_move(Board &board, Move move) {
     if (move.from == move.to) {
         // explode, killing all items in a 2 by 2 radius
-        // we can't access the board's members directly, so we do workaround
-
-        // first, find the targets that get killed by the blast
-        vector<Cell> targets;
-        for (int x = -2; x <= 2; ++x) {
-            for (int y = -2; y <= 2; ++y) {
-                Cell to(move.from.x + x, move.from.y + y);
-                if (board.contains(to) && is_opposite_team(board[to])) {
-                    targets.push_back(to);
-                }
-            }
+        board.make_explosion_move(move.from, 2);
+    } else {
+        // if not exploding, then just make classical chess move
+        board.make_classical_chess_move(move);
+    }
+}
+
+void King::get_moves(const Board &board, Cell from, MoveList &moves) const {
+    get_king_moves<false>(team, board, from, moves);
+}
+
+void King::get_captures(const Board &board, Cell from, MoveList &moves) const {
+    get_king_moves<true>(team, board, from, moves);
+}
+
+void Queen::get_moves(const Board &board, Cell from, MoveList &moves) const {
+    get_queen_moves<false>(team, board, from, moves);
+}
+
+void Queen::get_captures(const Board &board, Cell from, MoveList &moves) const {
+    get_queen_moves<true>(team, board, from, moves);
+}
+
+void Bishop::get_moves(const Board &board, Cell from, MoveList &moves) const {
+    get_bishop_moves<false>(team, board, from, moves);
+}
+
+void Bishop::get_captures(const Board &board, Cell from, MoveList &moves) const {
+    get_bishop_moves<true>(team, board, from, moves);
+}
+
+void Knight::get_moves(const Board &board, Cell from, MoveList &moves) const {
+    get_knight_moves<false>(team, board, from, moves);
+}
+
+void Knight::get_captures(const Board &board, Cell from, MoveList &moves) const {
+    get_knight_moves<true>(team, board, from, moves);
+}
+
+void Rook::get_moves(const Board &board, Cell from, MoveList &moves) const {
+    get_rook_moves<false>(team, board, from, moves);
+}
+
+void Rook::get_captures(const Board &board, Cell from, MoveList &moves) const {
+    get_rook_moves<true>(team, board, from, moves);
+}
+
+void Pawn::get_moves(const Board &board, Cell from, MoveList &moves) const {
+    get_pawn_moves<false>(team, y_move_steps, board, from, moves);
+}
+
+void Pawn::get_captures(const Board &board, Cell from, MoveList &moves) const {
+    get_pawn_moves<true>(team, y_move_steps, board, from, moves);
+}
+
+void Cannon::get_moves(const Board &board, Cell from, MoveList &moves) const {
+    get_cannon_moves<false>(team, board, from, moves);
+}
+
+void Cannon::get_captures(const Board &board, Cell from, MoveList &moves) const {
+    get_cannon_moves<true>(team, board, from, moves);
+}
+
+void BombTower::get_moves(const Board &board, Cell from, MoveList &moves) const {
+    get_bomb_tower_moves<false>(team, board, from, moves);
+}
+
+void BombTower::get_captures(const Board &board, Cell from, MoveList &moves) const {
+    get_bomb_tower_moves<true>(team, board, from, moves);
+}
+
+void BombTower::make_move(Board &board, Move move) const {
+    make_bomb_tower_move(board, move);
+}
+
+// Custom pieces don't know about the flags (see PackedMove), so they're
+// filled in after the moves from first_move onwards are added.
+static void add_custom_piece_flags(const Board &board, Cell from, size_t first_move, MoveList &moves) {
+    const ChessPiece &piece = board[from];
+    for (size_t i = first_move; i < moves.size(); ++i) {
+        Cell to = moves[i].to();
+        if (piece.is_opposite_team(board[to])) {
+            moves[i] = PackedMove(from, to, PackedMove::CAPTURE);
+        } else if (to == from) {
+            moves[i] = PackedMove(from, to, PackedMove::EXPLOSION);
         }
+    }
+}
 
-        // find an empty space
-        Cell empty_space_locat(0, 0);
-        for (size_t x = 0; x < board.get_width(); ++x) {
-            for (size_t y = 0; y < board.get_height(); ++y) {
-                Cell to(x, y);
-                if (board[to] == EMPTY_SPACE) {
-                    empty_space_locat = to;
-                    break;
-                }
+void get_custom_piece_moves(const Board &board, Cell from, MoveList &moves) {
+    size_t first_move = moves.size();
+    board[from].get_moves(board, from, moves);
+    add_custom_piece_flags(board, from, first_move, moves);
+}
+
+void get_custom_piece_captures(const Board &board, Cell from, MoveList &moves) {
+    size_t first_move = moves.size();
+    board[from].get_captures(board, from, moves);
+    add_custom_piece_flags(board, from, first_move, moves);
+}
+
+template <bool captures_only>
+static void get_moves_by_type(const Board &board, Cell from, MoveList &moves) {
+    uint8_t code = board.code_at(board.square_index(from));
+    Team team = ChessPiece::team_by_code[code];
+    switch (ChessPiece::type_by_code[code]) {
+        case KING:
+            get_king_moves<captures_only>(team, board, from, moves);
+            break;
+        case QUEEN:
+            get_queen_moves<captures_only>(team, board, from, moves);
+            break;
+        case BISHOP:
+            get_bishop_moves<captures_only>(team, board, from, moves);
+            break;
+        case KNIGHT:
+            get_knight_moves<captures_only>(team, board, from, moves);
+            break;
+        case ROOK:
+            get_rook_moves<captures_only>(team, board, from, moves);
+            break;
+        case PAWN:
+            get_pawn_moves<captures_only>(team, team == WHITE ? 1 : -1, board, from, moves);
+            break;
+        case CANNON:
+            get_cannon_moves<captures_only>(team, board, from, moves);
+            break;
+        case BOMB_TOWER:
+            get_bomb_tower_moves<captures_only>(team, board, from, moves);
+            break;
+        case CUSTOM:
+            if (captures_only) {
+                get_custom_piece_captures(board, from, moves);
+            } else {
+                get_custom_piece_moves(board, from, moves);
             }
-        }
+            break;
+        case EMPTY:
+        case NUM_PIECE_TYPES:
+            break;  // nothing there to move
+    }
+}
 
-        // then, kill them one by one
-        for (Cell target : targets) {
-            board.make_classical_chess_move(Move(empty_space_locat, target));
-        }
-        board.make_classical_chess_move(Move(empty_space_locat, move.to));
+void get_piece_moves(const Board &board, Cell from, MoveList &moves) {
+    get_moves_by_type<false>(board, from, moves);
+}
 
-        // make sure it is the correct team's turn
-        if ((targets.size() + 1) % 2 == 0) {
-            board.make_classical_chess_move(Move(empty_space_locat, empty_space_locat));
-        }
+void get_piece_captures(const Board &board, Cell from, MoveList &moves) {
+    get_moves_by_type<true>(board, from, moves);
+}
 
-    } else {
-        // if not exploding, then just make classical chess move
-        board.make_classical_chess_move(move);
+void make_piece_move(Board &board, Move move) {
+    uint8_t code = board.code_at(board.square_index(move.from));
+    switch (ChessPiece::type_by_code[code]) {
+        case BOMB_TOWER:
+            make_bomb_tower_move(board, move);
+            break;
+        case CUSTOM:
+            ChessPiece::piece_by_code[code]->make_move(board, move);
+            break;
+        case EMPTY:
+        case NUM_PIECE_TYPES:
+            break;  // nothing there to move (like EmptySpace::make_move)
+        default:
+            board.make_classical_chess_move(move);
+            break;
     }
 }
 
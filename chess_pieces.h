@@ -1,6 +1,7 @@
 #ifndef _CHESS_PIECES_H_
 #define _CHESS_PIECES_H_
 
+#include <cstdint>
 #include <iostream>
 #include <map>
 #include <vector>
@@ -17,89 +18,186 @@ class ChessPiece {
    public:
     const UTF8CodePoint utf8_codepoint;
     const Team team;
-
-    ChessPiece(UTF8CodePoint cp, Team team) : utf8_codepoint(cp), team(team) {}
-
-    virtual ~ChessPiece() {}
-
-    virtual void get_moves(const Board &board, Cell from, vector<Move> &moves) const = 0;
+    // Which built-in kind of piece this moves like (CUSTOM if none).
+    const PieceType type;
+    // The 1-byte code the Board stores for this piece. Every piece gets a
+    // unique code when it is constructed (EMPTY_SPACE is always EMPTY_CODE),
+    // and gives it back when it's destroyed, so a piece mustn't be destroyed
+    // while it's still on a board. There can be 254 pieces at once.
+    const uint8_t code;
+
+    ChessPiece(UTF8CodePoint cp, Team team, PieceType type = CUSTOM);
+    // A copy would have the same code, so pieces can't be copied.
+    ChessPiece(const ChessPiece &) = delete;
+    ChessPiece &operator=(const ChessPiece &) = delete;
+
+    virtual ~ChessPiece();
+
+    virtual void get_moves(const Board &board, Cell from, MoveList &moves) const = 0;
+    // Only the moves that take something: the ones onto a piece of the other
+    // team, and explosions that have one in range. By default that's
+    // get_moves without the rest, keeping every move that stays on from
+    // (there's no knowing what a custom piece's explosion hits).
+    virtual void get_captures(const Board &board, Cell from, MoveList &moves) const;
     virtual void make_move(Board &board, Move move) const = 0;
 
     bool is_opposite_team(const ChessPiece &other) const;
+    // Same as above, but looks at a code read straight out of the Board.
+    // OFF_BOARD is never on the opposite team.
+    bool is_opposite_team(uint8_t other_code) const {
+        Team other = team_by_code[other_code];
+        return (team == WHITE && other == BLACK) || (team == BLACK && other == WHITE);
+    }
+
+    static constexpr uint8_t EMPTY_CODE = 0;
+    // Used by the Board for the squares around the edge of the board.
+    static constexpr uint8_t OFF_BOARD = 255;
+
+    // Lookup tables from a code to its piece/team/type. OFF_BOARD maps to
+    // nullptr/NONE/EMPTY.
+    static const ChessPiece *piece_by_code[256];
+    static Team team_by_code[256];
+    static PieceType type_by_code[256];
+    // Each code's piece as UTF-8 bytes, worked out once when the piece is
+    // constructed so that boards can be written out without encoding them.
+    struct UTF8Bytes {
+        char bytes[4];
+        uint8_t size;
+    };
+    static UTF8Bytes utf8_by_code[256];
+    // The piece with code_point (nullptr if there isn't one), including
+    // custom pieces that aren't in ALL_CHESS_PIECES. It looks through every
+    // code, so it's for setting things up rather than for every square.
+    static const ChessPiece *with_code_point(char32_t code_point);
 
     bool operator==(const ChessPiece &other) const;
     bool operator!=(const ChessPiece &other) const;
 
     friend ostream &operator<<(ostream &os, const ChessPiece &p);
+
+   protected:
+    // Only used by EmptySpace, which always gets EMPTY_CODE.
+    ChessPiece(UTF8CodePoint cp, Team team, PieceType type, uint8_t code);
 };
 
 ostream &operator<<(ostream &os, const ChessPiece &p);
 
 class EmptySpace : public ChessPiece {
    public:
-    EmptySpace() : ChessPiece('.', NONE) {}
-    void get_moves(const Board &board, Cell from, vector<Move> &moves) const override {}
+    EmptySpace() : ChessPiece('.', NONE, EMPTY, EMPTY_CODE) {}
+    void get_moves(const Board &board, Cell from, MoveList &moves) const override {}
     void make_move(Board &board, Move move) const override {}
 };
 
 class SimpleChessPiece : public ChessPiece {
    public:
-    SimpleChessPiece(UTF8CodePoint cp, Team team) : ChessPiece(cp, team) {}
+    SimpleChessPiece(UTF8CodePoint cp, Team team, PieceType type = CUSTOM) : ChessPiece(cp, team, type) {}
     void make_move(Board &board, Move move) const;
 };
 
+// The built-in pieces. The board moves them with a switch on their PieceType
+// rather than a virtual call (see get_piece_moves below), so a subclass that
+// overrides get_moves, get_captures or make_move has to pass CUSTOM to the
+// protected constructor, or the board won't call its overrides.
 class King : public SimpleChessPiece {
    public:
-    King(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team) {}
-    void get_moves(const Board &board, Cell from, vector<Move> &moves) const override;
+    King(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team, KING) {}
+    void get_moves(const Board &board, Cell from, MoveList &moves) const override;
+    void get_captures(const Board &board, Cell from, MoveList &moves) const override;
+
+   protected:
+    King(UTF8CodePoint cp, Team team, PieceType type) : SimpleChessPiece(cp, team, type) {}
 };
 
 class Queen : public SimpleChessPiece {
    public:
-    Queen(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team) {}
-    void get_moves(const Board &board, Cell from, vector<Move> &moves) const override;
+    Queen(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team, QUEEN) {}
+    void get_moves(const Board &board, Cell from, MoveList &moves) const override;
+    void get_captures(const Board &board, Cell from, MoveList &moves) const override;
+
+   protected:
+    Queen(UTF8CodePoint cp, Team team, PieceType type) : SimpleChessPiece(cp, team, type) {}
 };
 
 class Bishop : public SimpleChessPiece {
    public:
-    Bishop(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team) {}
-    void get_moves(const Board &board, Cell from, vector<Move> &moves) const override;
+    Bishop(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team, BISHOP) {}
+    void get_moves(const Board &board, Cell from, MoveList &moves) const override;
+    void get_captures(const Board &board, Cell from, MoveList &moves) const override;
+
+   protected:
+    Bishop(UTF8CodePoint cp, Team team, PieceType type) : SimpleChessPiece(cp, team, type) {}
 };
 
 class Knight : public SimpleChessPiece {
    public:
-    Knight(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team) {}
-    void get_moves(const Board &board, Cell from, vector<Move> &moves) const override;
+    Knight(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team, KNIGHT) {}
+    void get_moves(const Board &board, Cell from, MoveList &moves) const override;
+    void get_captures(const Board &board, Cell from, MoveList &moves) const override;
+
+   protected:
+    Knight(UTF8CodePoint cp, Team team, PieceType type) : SimpleChessPiece(cp, team, type) {}
 };
 
 class Rook : public SimpleChessPiece {
    public:
-    Rook(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team) {}
-    void get_moves(const Board &board, Cell from, vector<Move> &moves) const override;
+    Rook(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team, ROOK) {}
+    void get_moves(const Board &board, Cell from, MoveList &moves) const override;
+    void get_captures(const Board &board, Cell from, MoveList &moves) const override;
+
+   protected:
+    Rook(UTF8CodePoint cp, Team team, PieceType type) : SimpleChessPiece(cp, team, type) {}
 };
 
 class Pawn : public SimpleChessPiece {
     int y_move_steps;
 
    public:
+    // Only pawns that move towards the other team's side are PAWNs, anything
+    // else is a CUSTOM piece as far as the board is concerned.
     Pawn(UTF8CodePoint cp, Team team, int y_move_steps)
-        : SimpleChessPiece(cp, team), y_move_steps(y_move_steps) {}
-    void get_moves(const Board &board, Cell from, vector<Move> &moves) const override;
+        : SimpleChessPiece(cp, team, y_move_steps == (team == WHITE ? 1 : -1) ? PAWN : CUSTOM), y_move_steps(y_move_steps) {}
+    void get_moves(const Board &board, Cell from, MoveList &moves) const override;
+    void get_captures(const Board &board, Cell from, MoveList &moves) const override;
 };
 
 class Cannon : public SimpleChessPiece {
    public:
-    Cannon(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team){};
-    void get_moves(const Board &board, Cell from, vector<Move> &moves) const override;
+    Cannon(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team, CANNON) {}
+    void get_moves(const Board &board, Cell from, MoveList &moves) const override;
+    void get_captures(const Board &board, Cell from, MoveList &moves) const override;
+
+   protected:
+    Cannon(UTF8CodePoint cp, Team team, PieceType type) : SimpleChessPiece(cp, team, type) {}
 };
 
 class BombTower : public SimpleChessPiece {
    public:
-    BombTower(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team){};
-    void get_moves(const Board &board, Cell from, vector<Move> &moves) const override;
+    BombTower(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team, BOMB_TOWER) {}
+    void get_moves(const Board &board, Cell from, MoveList &moves) const override;
+    void get_captures(const Board &board, Cell from, MoveList &moves) const override;
     void make_move(Board &board, Move move) const override;
+
+   protected:
+    BombTower(UTF8CodePoint cp, Team team, PieceType type) : SimpleChessPiece(cp, team, type) {}
 };
 
+// The same as board[from].get_moves(board, from, moves) and
+// board[move.from].make_move(board, move), but the built-in kinds of pieces
+// are picked out by their PieceType with a switch rather than a virtual call
+// (which is hard for the CPU to predict when every square holds a different
+// piece). Only CUSTOM pieces go through the virtual functions.
+void get_piece_moves(const Board &board, Cell from, MoveList &moves);
+void make_piece_move(Board &board, Move move);
+// The same as board[from].get_captures(board, from, moves), picked out the
+// same way.
+void get_piece_captures(const Board &board, Cell from, MoveList &moves);
+// board[from].get_moves(board, from, moves) (or get_captures), with the flags
+// (see PackedMove) filled in afterwards, since custom pieces don't know about
+// them.
+void get_custom_piece_moves(const Board &board, Cell from, MoveList &moves);
+void get_custom_piece_captures(const Board &board, Cell from, MoveList &moves);
+
 // `extern` is used to declare the variables here, without defining them
 // The actual variables/objects are defined in the corresponding .cpp file.
 extern const EmptySpace EMPTY_SPACE;
@@ -5,40 +5,64 @@
 #include <climits>
 #include <iostream>
 #include <random>
+#include <thread>
 
 #include "chess_board.h"
 #include "chess_pieces.h"
+#include "opening_book.h"
 
 using std::cin;
+using std::count_if;
 using std::cout;
+using std::default_random_engine;
 using std::endl;
 using std::numeric_limits;
-using std::shuffle;
 using std::vector;
 
 const char *Player::name() const {
     return team_name(team);
 }
 
+// Picks one of the moves that is_wanted(move) is true for at random (without
+// copying the moves). Returns false if there aren't any.
+template <typename Predicate>
+static bool pick_random_move(const MoveList &moves, Predicate is_wanted, default_random_engine &random_number_generator, Move &chosen) {
+    size_t num_wanted = count_if(moves.begin(), moves.end(), is_wanted);
+    if (num_wanted == 0) {
+        return false;
+    }
+    size_t wanted_index = random_number_generator() % num_wanted;
+    for (PackedMove move : moves) {
+        if (is_wanted(move) && wanted_index-- == 0) {
+            chosen = move;
+            break;
+        }
+    }
+    return true;
+}
+
 RandomPlayer::RandomPlayer(Team team) : Player(team) {
     // Initialize the pseudo-random number generator based on the current time,
     // so it chooses different numbers when you run the code at different times.
     random_number_generator.seed(std::chrono::system_clock::now().time_since_epoch().count());
 }
 
-Move RandomPlayer::get_move(const Board &board, const vector<Move> &moves) const {
+RandomPlayer::RandomPlayer(Team team, unsigned seed) : Player(team), random_number_generator(seed) {}
+
+Move RandomPlayer::get_move(const Board &board, const MoveList &moves) const {
     return moves[random_number_generator() % moves.size()];
 }
 
 HumanPlayer::HumanPlayer(Team team) : Player(team) {}
 
-Move HumanPlayer::get_move(const Board &board, const vector<Move> &moves) const {
+Move HumanPlayer::get_move(const Board &board, const MoveList &moves) const {
+    LegalMoves legal_moves(moves);
     Move move;
     while (true) {
         cout << "What's your move?: ";
         cin >> move;
         cout << endl;
-        if (find(moves.begin(), moves.end(), move) != moves.end()) {
+        if (legal_moves.is_legal(move)) {
             break;
         }
         cout << move << " is not a valid move! Please choose one of the following moves: \n";
@@ -57,15 +81,14 @@ CapturePlayer::CapturePlayer(Team team) : Player(team) {
         std::chrono::system_clock::now().time_since_epoch().count());
 }
 
-Move CapturePlayer::get_move(const Board &board, const vector<Move> &moves) const {
-    vector<Move> shuffled_moves = moves;
-    shuffle(shuffled_moves.begin(), shuffled_moves.end(), random_number_generator);
-    for (Move move : shuffled_moves) {
-        if (board[move.from].is_opposite_team(board[move.to])) {
-            return move;
-        }
+CapturePlayer::CapturePlayer(Team team, unsigned seed) : Player(team), random_number_generator(seed) {}
+
+Move CapturePlayer::get_move(const Board &board, const MoveList &moves) const {
+    MoveList captures = board.get_captures();
+    if (!captures.empty()) {
+        return captures[random_number_generator() % captures.size()];
     }
-    return shuffled_moves[0];
+    return moves[random_number_generator() % moves.size()];
 }
 
 CheckMateCapturePlayer::CheckMateCapturePlayer(Team team) : Player(team) {
@@ -75,99 +98,293 @@ CheckMateCapturePlayer::CheckMateCapturePlayer(Team team) : Player(team) {
         std::chrono::system_clock::now().time_since_epoch().count());
 }
 
-Move CheckMateCapturePlayer::get_move(const Board &board, const vector<Move> &moves) const {
-    vector<Move> shuffled_moves = moves;
-    shuffle(shuffled_moves.begin(), shuffled_moves.end(), random_number_generator);
-    for (Move move : shuffled_moves) {
-        if (board[move.from].is_opposite_team(board[move.to]) && (board[move.to] == WHITE_KING || board[move.to] == BLACK_KING)) {
-            return move;
+CheckMateCapturePlayer::CheckMateCapturePlayer(Team team, unsigned seed) : Player(team), random_number_generator(seed) {}
+
+Move CheckMateCapturePlayer::get_move(const Board &board, const MoveList &moves) const {
+    MoveList captures = board.get_captures();
+    if (captures.empty()) {
+        return moves[random_number_generator() % moves.size()];
+    }
+    auto captures_king = [&](PackedMove move) {
+        return board.captures_king(move);
+    };
+    Move move;
+    if (pick_random_move(captures, captures_king, random_number_generator, move)) {
+        return move;
+    }
+    return captures[random_number_generator() % captures.size()];
+}
+
+AIPlayer::AIPlayer(Team team, size_t table_megabytes, int search_depth, int milliseconds_per_move, uint64_t nodes_per_move, int num_threads)
+    : Player(team),
+      opening_book(nullptr),
+      book_min_games(1),
+      search_depth(search_depth),
+      milliseconds_per_move(milliseconds_per_move),
+      nodes_per_move(nodes_per_move),
+      last_info{0, 0, false},
+      table(table_megabytes),
+      threads(num_threads < 1 ? 1 : num_threads) {
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].index = i;
+        threads[i].killers.resize(search_depth + 1);
+        threads[i].move_scores.resize(search_depth + 1);
+    }
+}
+
+void AIPlayer::use_opening_book(const OpeningBook *book, uint32_t min_games) {
+    opening_book = book;
+    book_min_games = min_games;
+}
+
+Move AIPlayer::get_move(const Board &board, const MoveList &moves) const {
+    Move book_move;
+    if (opening_book != nullptr && opening_book->choose_move(board, moves, book_min_games, book_move)) {
+        last_info = {0, 0, true};
+        return book_move;
+    }
+
+    search_start = std::chrono::steady_clock::now();
+    stop_all_threads = false;
+    size_t history_size = 256 * board.get_width() * board.get_height();
+    for (SearchThread &thread : threads) {
+        thread.board = board;
+        if (thread.history.size() != history_size) {
+            thread.history.assign(history_size, 0);
+        } else {
+            // what was good last move is probably still good, but less so
+            for (int &score : thread.history) {
+                score /= 2;
+            }
+        }
+        for (array<PackedMove, 2> &ply_killers : thread.killers) {
+            ply_killers.fill(PackedMove(Cell(-1, -1), Cell(-1, -1)));
         }
+        thread.nodes = 0;
+        thread.stopped = false;
+        thread.best_move = moves[0];
+        thread.depth_done = 0;
+    }
+
+    // Lazy SMP: the helper threads search the same moves as this one, but
+    // they get out of step with it (and each other), so they fill the table
+    // with positions it's about to need. Only this thread's move gets played.
+    vector<std::thread> helpers;
+    for (size_t i = 1; i < threads.size(); ++i) {
+        helpers.emplace_back([this, &moves, i]() {
+            iterative_deepening(threads[i], moves);
+        });
     }
-    for (Move move : shuffled_moves) {
-        if (board[move.from].is_opposite_team(board[move.to])) {
-            return move;
+    iterative_deepening(threads[0], moves);
+    stop_all_threads = true;
+    for (std::thread &helper : helpers) {
+        helper.join();
+    }
+
+    last_info.depth = threads[0].depth_done;
+    last_info.nodes = 0;
+    last_info.from_book = false;
+    for (const SearchThread &thread : threads) {
+        last_info.nodes += thread.nodes;
+    }
+    return threads[0].best_move;
+}
+
+AIPlayer::SearchInfo AIPlayer::last_search_info() const {
+    return last_info;
+}
+
+void AIPlayer::iterative_deepening(SearchThread &thread, const MoveList &moves) const {
+    // The first search starts with the table's move. After that, each
+    // search starts with the move the one before it found, since it's
+    // probably still the best.
+    TranspositionTable::Entry entry;
+    bool has_table_move = table.probe(thread.board.hash(), entry);
+    MoveList ordered_moves = moves;
+    // every other helper thread searches one move deeper
+    for (int depth = 1 + thread.index % 2; depth <= search_depth; ++depth) {
+        const PackedMove *first_move = thread.depth_done > 0 ? &thread.best_move : (has_table_move ? &entry.best_move : nullptr);
+        PackedMove move = search_root(thread, ordered_moves, depth, first_move);
+        if (thread.stopped) {
+            break;  // didn't finish, so this search's move can't be trusted
         }
+        thread.best_move = move;
+        thread.depth_done = depth;
     }
-    return shuffled_moves[0];
 }
 
-AIPlayer::AIPlayer(Team team) : Player(team) {}
-Move AIPlayer::get_move(const Board &board, const vector<Move> &moves) const {
-    Board copy = Board(board);
-    vector<int> vals = minimax(copy, moves, 3, team);
-    return moves[vals[1]];
+PackedMove AIPlayer::search_root(SearchThread &thread, MoveList &moves, int depth, const PackedMove *first_move) const {
+    Board &board = thread.board;
+    vector<int> &scores = score_moves(thread, moves, 0, first_move);
+    int alpha = -numeric_limits<int>::max();
+    PackedMove best_move = moves[0];
+    for (size_t i = 0; i < moves.size(); ++i) {
+        PackedMove move = pick_next_move(moves, scores, i);
+        board.make_move(move);
+        int score = -search(thread, depth - 1, -numeric_limits<int>::max(), -alpha, 1);
+        board.unmake_move();
+        if (thread.stopped) {
+            return best_move;
+        }
+        if (score > alpha) {
+            alpha = score;
+            best_move = move;
+        }
+    }
+    table.store(board.hash(), alpha, depth, TranspositionTable::EXACT, best_move);
+    return best_move;
 }
 
-vector<int> AIPlayer::minimax(const Board &board, const vector<Move> &moves, int depth, Team cur_team) const {
+bool AIPlayer::out_of_budget(SearchThread &thread) const {
+    if (thread.stopped) {
+        return true;
+    }
+    if (thread.index != 0) {
+        // helpers stop when the main thread is done
+        thread.stopped = stop_all_threads.load(std::memory_order_relaxed);
+        return thread.stopped;
+    }
+    if (thread.depth_done == 0) {
+        return false;  // there's no move to play yet
+    }
+    // looking at the clock is slow enough to only do it every so often
+    if ((nodes_per_move != 0 && thread.nodes >= nodes_per_move) ||
+        (milliseconds_per_move != 0 && thread.nodes % 1024 == 0 &&
+         std::chrono::steady_clock::now() - search_start >= std::chrono::milliseconds(milliseconds_per_move))) {
+        thread.stopped = true;
+    }
+    return thread.stopped;
+}
+
+int AIPlayer::search(SearchThread &thread, int depth, int alpha, int beta, int ply) const {
+    Board &board = thread.board;
+    ++thread.nodes;
+    if (out_of_budget(thread)) {
+        return 0;  // nobody will look at this
+    }
     if (depth == 0 || board.winner() != NONE) {
-        // count black, white pieces existing
-        // note that the 8's should be replace with board.get_width() or board.get_height()
-        // if the board supports that
-        int black_count = 0, white_count = 0;
-        for (size_t y = 0; y < 8; ++y) {
-            for (size_t x = 0; x < 8; ++x) {
-                const ChessPiece *cur_piece = &board[Cell(x, y)];
-                Team cur_piece_team = cur_piece->team;
-                if (cur_piece_team == BLACK) {
-                    if (weights.find(cur_piece) != weights.end()) {
-                        black_count += weights.at(cur_piece);
-                    } else {
-                        // assume all custom pieces are worth x amount
-                        black_count += custom_weight;
-                    }
-                }
-                if (cur_piece_team == WHITE) {
-                    if (weights.find(cur_piece) != weights.end()) {
-                        white_count += weights.at(cur_piece);
-                    } else {
-                        // assume all custom pieces are worth x amount
-                        white_count += custom_weight;
-                    }
-                }
-            }
+        return evaluate(board);
+    }
+
+    // a search of this position that's at least as deep may already know the answer
+    int original_alpha = alpha;
+    TranspositionTable::Entry entry;
+    bool has_table_move = table.probe(board.hash(), entry);
+    if (has_table_move && entry.depth >= depth) {
+        if (entry.bound == TranspositionTable::EXACT) {
+            return entry.score;
+        } else if (entry.bound == TranspositionTable::LOWER) {
+            alpha = std::max(alpha, entry.score);
+        } else {
+            beta = std::min(beta, entry.score);
+        }
+        if (alpha >= beta) {
+            return entry.score;
         }
+    }
 
-        return {(team == WHITE ? 1 : -1) * (white_count - black_count), 0};
+    MoveList moves = board.get_moves();
+    if (moves.empty()) {
+        return evaluate(board);
     }
+    vector<int> &scores = score_moves(thread, moves, ply, has_table_move ? &entry.best_move : nullptr);
 
-    if (cur_team == team) {
-        int max_value = numeric_limits<int>::min();
-        int best_idx = 0;
-        for (size_t i = 0; i < moves.size(); ++i) {
-            Board temp(board);
-            temp.make_move(moves[i]);
-            vector<int> vals = minimax(temp, temp.get_moves(), depth - 1, Team(static_cast<int>(!(team - 1)) + 1));
-            if (vals[0] > max_value) {
-                max_value = vals[0];
-                best_idx = i;
+    int best_score = -numeric_limits<int>::max();
+    PackedMove best_move = moves[0];
+    for (size_t i = 0; i < moves.size(); ++i) {
+        PackedMove move = pick_next_move(moves, scores, i);
+        board.make_move(move);
+        int score = -search(thread, depth - 1, -beta, -alpha, ply + 1);
+        board.unmake_move();
+        if (thread.stopped) {
+            return 0;  // don't put the unfinished score in the table
+        }
+        if (score > best_score) {
+            best_score = score;
+            best_move = move;
+        }
+        if (score > alpha) {
+            alpha = score;
+        }
+        if (alpha >= beta) {
+            // the other team won't let us get here, so there's no need to look at the other moves
+            if (!move.is_capture()) {
+                remember_cutoff(thread, move, depth, ply);
             }
+            break;
         }
+    }
 
-        return {max_value, best_idx};
-    } else {
-        int min_value = numeric_limits<int>::max();
-        int best_idx = 0;
+    TranspositionTable::Bound bound = TranspositionTable::EXACT;
+    if (best_score <= original_alpha) {
+        bound = TranspositionTable::UPPER;
+    } else if (best_score >= beta) {
+        bound = TranspositionTable::LOWER;
+    }
+    table.store(board.hash(), best_score, depth, bound, best_move);
+    return best_score;
+}
 
-        // first, find if there are any moves that result in capture
-        vector<Move> choices;
-        for (Move move : moves) {
-            if (board[move.from].is_opposite_team(board[move.to])) {
-                choices.push_back(move);
-            }
+int AIPlayer::evaluate(const Board &board) const {
+    return (board.get_current_teams_turn() == WHITE ? 1 : -1) * (board.material(WHITE) - board.material(BLACK));
+}
+
+vector<int> &AIPlayer::score_moves(SearchThread &thread, const MoveList &moves, int ply, const PackedMove *table_move) const {
+    const Board &board = thread.board;
+    const int TABLE_MOVE = 1 << 30, CAPTURE = 1 << 29, KILLER = 1 << 28;
+    vector<int> &scores = thread.move_scores[ply];
+    scores.resize(moves.size());
+    for (size_t i = 0; i < moves.size(); ++i) {
+        if (table_move != nullptr && moves[i] == *table_move) {
+            scores[i] = TABLE_MOVE;
+        } else if (moves[i].is_capture()) {
+            int attacker = board.piece_value(board[moves[i].from()]);
+            int victim = board.piece_value(board[moves[i].to()]);
+            scores[i] = CAPTURE + victim * 256 - attacker;
+        } else if (moves[i] == thread.killers[ply][0]) {
+            scores[i] = KILLER + 1;
+        } else if (moves[i] == thread.killers[ply][1]) {
+            scores[i] = KILLER;
+        } else {
+            scores[i] = history_score(thread, moves[i]);
         }
+    }
+    return scores;
+}
 
-        // then iterate through all the valid moves (either all the moves if none result in capture
-        // or just the ones that result in capture)
-        const vector<Move> actual_choices = (choices.size() == 0 ? moves : choices);
-        for (size_t i = 0; i < actual_choices.size(); ++i) {
-            Board temp(board);
-            temp.make_move(actual_choices[i]);
-            vector<int> vals = minimax(temp, temp.get_moves(), depth - 1, Team(static_cast<int>(!(team - 1)) + 1));
-            if (vals[0] < min_value) {
-                min_value = vals[0];
-                best_idx = i;
-            }
+PackedMove AIPlayer::pick_next_move(MoveList &moves, vector<int> &scores, size_t next) {
+    // Only sorting as far as the search gets saves time when it stops early,
+    // which it usually does.
+    size_t best = next;
+    for (size_t i = next + 1; i < moves.size(); ++i) {
+        if (scores[i] > scores[best]) {
+            best = i;
         }
-        return {min_value, best_idx};
     }
-}
\ No newline at end of file
+    std::swap(moves[next], moves[best]);
+    std::swap(scores[next], scores[best]);
+    return moves[next];
+}
+
+void AIPlayer::remember_cutoff(SearchThread &thread, PackedMove move, int depth, int ply) const {
+    array<PackedMove, 2> &ply_killers = thread.killers[ply];
+    if (ply_killers[0] != move) {
+        ply_killers[1] = ply_killers[0];
+        ply_killers[0] = move;
+    }
+
+    int &score = history_score(thread, move);
+    score += depth * depth;
+    if (score >= (1 << 20)) {
+        // keep the history scores well below the killer moves'
+        for (int &other_score : thread.history) {
+            other_score /= 2;
+        }
+    }
+}
+
+int &AIPlayer::history_score(SearchThread &thread, PackedMove move) const {
+    const Board &board = thread.board;
+    size_t to = move.to().y * board.get_width() + move.to().x;
+    return thread.history[board[move.from()].code * board.get_width() * board.get_height() + to];
+}
@@ -1,12 +1,20 @@
 #ifndef _CHESS_PLAYER_H_
 #define _CHESS_PLAYER_H_
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <random>
 #include <vector>
 
 #include "chess_board.h"
 #include "chess_pieces.h"
+#include "transposition_table.h"
 
+class OpeningBook;
+
+using std::array;
 using std::vector;
 
 class Player {
@@ -14,9 +22,13 @@ class Player {
     const Team team;
 
     Player(Team team) : team(team) {}
+    // Players are deleted through Player pointers (see Tournament).
+    virtual ~Player() {}
 
-    virtual Move get_move(const Board &board, const vector<Move> &moves) const = 0;
+    virtual Move get_move(const Board &board, const MoveList &moves) const = 0;
     virtual const char *name() const;
+    // What kind of player this is (the name of its class), for game records.
+    virtual const char *kind() const = 0;
 };
 
 class RandomPlayer : public Player {
@@ -24,24 +36,36 @@ class RandomPlayer : public Player {
 
    public:
     RandomPlayer(Team team);
+    // Makes the same choices every time it's given the same seed.
+    RandomPlayer(Team team, unsigned seed);
 
-    Move get_move(const Board &board, const vector<Move> &moves) const override;
+    Move get_move(const Board &board, const MoveList &moves) const override;
+    const char *kind() const override {
+        return "RandomPlayer";
+    }
 };
 
 class HumanPlayer : public Player {
    public:
     HumanPlayer(Team team);
-    Move get_move(const Board &board, const vector<Move> &moves) const override;
+    Move get_move(const Board &board, const MoveList &moves) const override;
+    const char *kind() const override {
+        return "HumanPlayer";
+    }
 };
 
-// CapturePlayer plays a random move that captures an opponents piece.
-// If there is no such move, then it plays a random move.
+// CapturePlayer plays a random move that captures an opponents piece (see
+// Board::get_captures). If there is no such move, then it plays a random move.
 class CapturePlayer : public Player {
     mutable std::default_random_engine random_number_generator;
 
    public:
     CapturePlayer(Team team);
-    Move get_move(const Board &board, const vector<Move> &moves) const override;
+    CapturePlayer(Team team, unsigned seed);
+    Move get_move(const Board &board, const MoveList &moves) const override;
+    const char *kind() const override {
+        return "CapturePlayer";
+    }
 };
 
 class CheckMateCapturePlayer : public Player {
@@ -49,31 +73,113 @@ class CheckMateCapturePlayer : public Player {
 
    public:
     CheckMateCapturePlayer(Team team);
-    Move get_move(const Board &board, const vector<Move> &moves) const override;
+    CheckMateCapturePlayer(Team team, unsigned seed);
+    Move get_move(const Board &board, const MoveList &moves) const override;
+    const char *kind() const override {
+        return "CheckMateCapturePlayer";
+    }
 };
 
 class AIPlayer : public Player {
    public:
-    AIPlayer(Team team);
-    Move get_move(const Board &board, const vector<Move> &moves) const override;
+    // search_depth is how many moves (of either team) ahead the AI looks.
+    // table_megabytes is how much memory the transposition table (which
+    // remembers searched positions from one move to the next) can use.
+    // The AI searches 1 move ahead, then 2, and so on up to search_depth. If
+    // it runs out of time (milliseconds_per_move) or positions
+    // (nodes_per_move) partway through, it plays the best move of the deepest
+    // search it finished. It always finishes searching 1 move ahead. A limit
+    // of 0 means no limit (and a position limit only counts the positions
+    // the first thread searches).
+    // With num_threads > 1, the other threads search alongside the first one
+    // and share what they find through the transposition table, which helps
+    // the first one get deeper in the same time. With 1 thread, the same
+    // position (and table) always gives the same move, unless there's a time limit.
+    AIPlayer(Team team, size_t table_megabytes = 16, int search_depth = 4, int milliseconds_per_move = 0, uint64_t nodes_per_move = 0,
+             int num_threads = 1);
+    // Plays the best scoring move in book (see OpeningBook::choose_move),
+    // straight away, whenever there is one played in at least min_games
+    // games, and only searches when there isn't. The book isn't copied, so
+    // it has to last as long as the player; nullptr stops using one.
+    void use_opening_book(const OpeningBook *book, uint32_t min_games = 1);
+    Move get_move(const Board &board, const MoveList &moves) const override;
+    const char *kind() const override {
+        return "AIPlayer";
+    }
+
+    // What the last get_move did.
+    struct SearchInfo {
+        int depth;       // how deep the search that chose the move went
+        uint64_t nodes;  // how many positions all the threads searched (including unfinished searches)
+        bool from_book;  // it came from the opening book (without searching at all)
+    };
+    SearchInfo last_search_info() const;
 
    private:
-    vector<int> minimax(const Board &board, const vector<Move> &moves, int depth, Team cur_team) const;
-    const int king_weight = 100;
-    const int custom_weight = 5;
-    const map<const ChessPiece *, int> weights = {
-        {&WHITE_PAWN, 1},
-        {&BLACK_PAWN, 1},
-        {&WHITE_KNIGHT, 3},
-        {&BLACK_KNIGHT, 3},
-        {&WHITE_BISHOP, 3},
-        {&BLACK_BISHOP, 3},
-        {&WHITE_ROOK, 5},
-        {&BLACK_ROOK, 5},
-        {&WHITE_QUEEN, 9},
-        {&BLACK_QUEEN, 9},
-        {&WHITE_KING, king_weight},
-        {&BLACK_KING, king_weight}};
+    // Everything one searching thread needs for itself.
+    struct SearchThread {
+        size_t index;  // 0 is the main thread
+        Board board;   // the position being searched (moves are made and unmade on it)
+        // The last 2 quiet moves that made the search stop early, for each ply.
+        vector<array<PackedMove, 2>> killers;
+        // The scores of the moves being searched at each ply (see
+        // score_moves), kept so that they don't have to be allocated again.
+        vector<vector<int>> move_scores;
+        // How often moving each piece (by code) to each square made the search
+        // stop early, weighted by how deep it was. Kept (but faded) from one
+        // move to the next.
+        vector<int> history;
+        uint64_t nodes;
+        // Set once the thread runs out of time or positions (or, for a
+        // helper, once the main thread is done); every search returns straight away after that.
+        bool stopped;
+        // the best move of the deepest search it has finished, and how deep that was
+        PackedMove best_move;
+        int depth_done;
+    };
+
+    // Searches thread.board 1 move ahead, then 2, ... until it's searched
+    // search_depth moves ahead or it's stopped.
+    void iterative_deepening(SearchThread &thread, const MoveList &moves) const;
+    // Searches every move in moves depth moves ahead (first_move first, if
+    // it's given) and returns the best one. moves gets reordered.
+    PackedMove search_root(SearchThread &thread, MoveList &moves, int depth, const PackedMove *first_move) const;
+    // Negamax with alpha-beta pruning: returns the score of thread.board for
+    // the team whose turn it is, looking depth moves ahead. Scores at or
+    // below alpha, or at or above beta, are only bounds (the search stops as
+    // soon as it knows the score is outside them). ply is how many moves deep
+    // the board is from the position get_move was asked about.
+    // Searches by making and unmaking moves on the board, which ends up the way it started.
+    int search(SearchThread &thread, int depth, int alpha, int beta, int ply) const;
+    // The material score of board (see Board::material) for the team whose
+    // turn it is.
+    int evaluate(const Board &board) const;
+    // Scores moves so that the ones most likely to be best can be searched
+    // first, which lets alpha-beta skip more of the others: table_move (the
+    // best move last time this position was searched), then captures (most
+    // valuable victim first, cheapest attacker first), then the killer moves
+    // of this ply, then the rest by their history score. The scores go in
+    // thread.move_scores[ply].
+    vector<int> &score_moves(SearchThread &thread, const MoveList &moves, int ply, const PackedMove *table_move) const;
+    // Moves the highest scoring move from next onwards to next and returns it.
+    static PackedMove pick_next_move(MoveList &moves, vector<int> &scores, size_t next);
+    // Remembers that quiet move made the search stop early at ply.
+    void remember_cutoff(SearchThread &thread, PackedMove move, int depth, int ply) const;
+    int &history_score(SearchThread &thread, PackedMove move) const;
+    // Checks whether thread should stop searching, and sets thread.stopped if so.
+    bool out_of_budget(SearchThread &thread) const;
+
+    const OpeningBook *opening_book;
+    uint32_t book_min_games;
+    const int search_depth;
+    const int milliseconds_per_move;
+    const uint64_t nodes_per_move;
+    mutable std::chrono::steady_clock::time_point search_start;
+    mutable SearchInfo last_info;
+    // shared by all the threads
+    mutable TranspositionTable table;
+    mutable vector<SearchThread> threads;
+    mutable std::atomic<bool> stop_all_threads;
 };
 
 #endif  // _CHESS_PLAYER_H_
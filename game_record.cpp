@@ -0,0 +1,201 @@
+#include "game_record.h"
+
+#include <cstdint>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include "chess_board.h"
+#include "chess_pieces.h"
+
+using std::invalid_argument;
+using std::map;
+using std::stringstream;
+
+static const char MAGIC[4] = {'S', 'C', 'G', 'R'};
+static const uint8_t VERSION = 1;
+
+// Adds the num_bytes lowest bytes of value to bytes, lowest first.
+static void put(string &bytes, uint32_t value, int num_bytes) {
+    for (int i = 0; i < num_bytes; ++i) {
+        bytes += static_cast<char>(value >> (8 * i) & 0xff);
+    }
+}
+
+// Reads a num_bytes little-endian number.
+static uint32_t get(istream &is, int num_bytes) {
+    char bytes[4];
+    if (!is.read(bytes, num_bytes)) {
+        throw invalid_argument("game record ends early");
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < num_bytes; ++i) {
+        value |= static_cast<uint32_t>(static_cast<uint8_t>(bytes[i])) << (8 * i);
+    }
+    return value;
+}
+
+static Team get_team(istream &is) {
+    uint32_t team = get(is, 1);
+    if (team != NONE && team != BLACK && team != WHITE) {
+        throw invalid_argument("game record has a team that doesn't exist");
+    }
+    return static_cast<Team>(team);
+}
+
+static void put_name(string &bytes, const string &name) {
+    size_t length = name.size() < 0xffff ? name.size() : 0xffff;
+    put(bytes, length, 2);
+    bytes.append(name, 0, length);
+}
+
+static string get_name(istream &is) {
+    string name(get(is, 2), '\0');
+    if (!is.read(&name[0], name.size())) {
+        throw invalid_argument("game record ends early");
+    }
+    return name;
+}
+
+void write_game_record_header(ostream &os) {
+    os.write(MAGIC, sizeof(MAGIC));
+    os.put(VERSION);
+}
+
+void read_game_record_header(istream &is) {
+    char magic[sizeof(MAGIC)];
+    if (!is.read(magic, sizeof(MAGIC)) || string(magic, sizeof(MAGIC)) != string(MAGIC, sizeof(MAGIC))) {
+        throw invalid_argument("not a file of game records");
+    }
+    if (is.get() != VERSION) {
+        throw invalid_argument("game records of a version this can't read");
+    }
+}
+
+void write_game_record(ostream &os, const GameRecord &record) {
+    const Board &board = record.start;
+    int width = board.get_width(), height = board.get_height();
+    string bytes;
+    put(bytes, width, 1);
+    put(bytes, height, 1);
+
+    // the pieces, as indexes into the list of different ones
+    map<uint8_t, uint8_t> index_by_code;
+    string pieces;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const ChessPiece &piece = board[Cell(x, y)];
+            auto found = index_by_code.find(piece.code);
+            if (found == index_by_code.end()) {
+                found = index_by_code.emplace(piece.code, index_by_code.size()).first;
+            }
+            pieces += static_cast<char>(found->second);
+        }
+    }
+    put(bytes, index_by_code.size(), 1);
+    // in order of index, so the reader can number them as they come
+    vector<char32_t> code_points(index_by_code.size());
+    for (const auto &code_and_index : index_by_code) {
+        code_points[code_and_index.second] = ChessPiece::piece_by_code[code_and_index.first]->utf8_codepoint;
+    }
+    for (char32_t code_point : code_points) {
+        put(bytes, code_point, 4);
+    }
+    bytes += pieces;
+    put(bytes, board.get_current_teams_turn(), 1);
+
+    put_name(bytes, record.white_player);
+    put_name(bytes, record.black_player);
+
+    int square_bytes = width * height <= 256 ? 1 : 2;
+    put(bytes, record.moves.size(), 4);
+    for (Move move : record.moves) {
+        put(bytes, move.from.y * width + move.from.x, square_bytes);
+        put(bytes, move.to.y * width + move.to.x, square_bytes);
+    }
+    put(bytes, record.winner, 1);
+
+    os.write(bytes.data(), bytes.size());
+}
+
+bool read_game_record(istream &is, GameRecord &record) {
+    if (is.peek() == istream::traits_type::eof()) {
+        return false;
+    }
+    int width = get(is, 1), height = get(is, 1);
+    if (width < 2 || width > 26 || height < 2 || height > 99) {
+        throw invalid_argument("game record has a board size that isn't allowed");
+    }
+
+    vector<const ChessPiece *> pieces(get(is, 1));
+    for (const ChessPiece *&piece : pieces) {
+        // custom pieces too, as long as they've been made
+        piece = ChessPiece::with_code_point(get(is, 4));
+        if (piece == nullptr) {
+            throw invalid_argument("game record has a piece that doesn't exist");
+        }
+    }
+    Board board(width, height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            size_t index = get(is, 1);
+            if (index >= pieces.size()) {
+                throw invalid_argument("game record has a piece that isn't in its list of pieces");
+            }
+            board.set_piece(Cell(x, y), *pieces[index]);
+        }
+    }
+    board.set_current_teams_turn(get_team(is));
+    record.start = board;
+
+    record.white_player = get_name(is);
+    record.black_player = get_name(is);
+
+    int num_squares = width * height;
+    int square_bytes = num_squares <= 256 ? 1 : 2;
+    uint32_t num_moves = get(is, 4);
+    record.moves.clear();
+    for (uint32_t i = 0; i < num_moves; ++i) {
+        int from = get(is, square_bytes), to = get(is, square_bytes);
+        if (from >= num_squares || to >= num_squares) {
+            throw invalid_argument("game record has a move that isn't on the board");
+        }
+        record.moves.emplace_back(Cell(from % width, from / width), Cell(to % width, to / width));
+    }
+    record.winner = get_team(is);
+    return true;
+}
+
+void write_game_text(ostream &os, const GameRecord &record, LogLevel level) {
+    Board board = record.start;
+    if (level >= LOG_MOVES) {
+        for (Move move : record.moves) {
+            Team team = board.get_current_teams_turn();
+            if (level >= LOG_BOARDS) {
+                os << board << '\n'
+                   << team_name(team) << "'s turn.\n";
+            }
+            if (!board.get_legal_moves().is_legal(move)) {
+                stringstream err_msg;
+                err_msg << "game record has a move that isn't legal: " << move;
+                throw invalid_argument(err_msg.str());
+            }
+            os << team_name(team) << " chose to move " << board[move.from] << " from " << move.from
+               << " to " << move.to << " (" << board[move.to] << ")\n";
+            if (level >= LOG_BOARDS) {
+                os << '\n';
+            }
+            board.make_move(move);
+        }
+        if (level >= LOG_BOARDS) {
+            os << board << '\n';
+        }
+    }
+    os << record.white_player << " (White) vs " << record.black_player << " (Black): ";
+    if (record.winner == NONE) {
+        os << "nobody won";
+    } else {
+        os << team_name(record.winner) << " won";
+    }
+    os << " after " << record.moves.size() << " moves\n";
+}
@@ -0,0 +1,61 @@
+#ifndef _GAME_RECORD_H_
+#define _GAME_RECORD_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "chess_board.h"
+
+using std::istream;
+using std::ostream;
+using std::string;
+using std::vector;
+
+// Everything needed to play a game over again: the board it started on
+// (including whose turn it was), who played it, every move and who won.
+struct GameRecord {
+    Board start;
+    string white_player, black_player;
+    vector<Move> moves;
+    Team winner = NONE;  // NONE if nobody won
+};
+
+// A file of game records is a header (the 4 bytes "SCGR" and a version
+// byte) and then the records one after another. Each record is:
+//   the width and height of the board (1 byte each)
+//   the pieces that are on the starting board: how many different ones
+//     there are (1 byte) and each one's code point (4 bytes), then for each
+//     square (in the order y * width + x) which of those it holds (1 byte)
+//   whose turn it is at the start (1 byte, a Team)
+//   the white and black players' names (a 2 byte length, then the bytes)
+//   the number of moves (4 bytes), then each move's from and to squares
+//     (y * width + x), 1 byte each on boards of up to 256 squares and 2
+//     bytes each on bigger ones
+//   the winner (1 byte, a Team)
+// Numbers are little-endian. An 8 by 8 game of 100 moves takes about 300 bytes.
+void write_game_record_header(ostream &os);
+// Throws invalid_argument if is doesn't start with a game record header (of
+// a version this can read).
+void read_game_record_header(istream &is);
+
+void write_game_record(ostream &os, const GameRecord &record);
+// Reads the next record of is into record. Returns false if there are no
+// more, and throws invalid_argument if the record is cut short or makes no
+// sense (a piece that doesn't exist, a square that isn't on the board, ...).
+// Pieces are found by their code point, so custom pieces are read back as
+// long as they've been made (see ChessPiece::with_code_point).
+bool read_game_record(istream &is, GameRecord &record);
+
+// How much of a game write_game_text writes.
+enum LogLevel {
+    LOG_RESULTS,  // one line with who played and who won
+    LOG_MOVES,    // every move, then the result
+    LOG_BOARDS    // the board before every move too
+};
+
+// Writes record as text by playing it over again from the start. Throws
+// invalid_argument if one of the moves isn't legal where it's played.
+void write_game_text(ostream &os, const GameRecord &record, LogLevel level);
+
+#endif  // _GAME_RECORD_H_
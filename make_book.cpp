@@ -0,0 +1,70 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "game_record.h"
+#include "opening_book.h"
+
+using namespace std;
+
+// Builds an opening book (see opening_book.h) out of the games in files of
+// game records, like the ones chess --record writes.
+//
+// usage: make_book [options] BOOK RECORD_FILE...
+//   --moves N       how many moves (of either team) at the start of each
+//                   game to put in the book (default 12)
+//   --min-games N   leave out the moves played in fewer than N games
+//                   (default 1)
+// Exits with 1 if a file can't be read or written, or isn't what it should be.
+
+int main(int argc, const char *argv[]) {
+    int max_moves = 12;
+    uint32_t min_games = 1;
+    vector<const char *> file_names;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--moves") == 0 && i + 1 < argc) {
+            max_moves = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--min-games") == 0 && i + 1 < argc) {
+            min_games = strtoul(argv[++i], nullptr, 10);
+        } else {
+            file_names.push_back(argv[i]);
+        }
+    }
+    if (file_names.size() < 2) {
+        cerr << "usage: make_book [--moves N] [--min-games N] BOOK RECORD_FILE..." << endl;
+        return 1;
+    }
+
+    OpeningBookBuilder builder(max_moves);
+    uint64_t num_games = 0;
+    for (size_t i = 1; i < file_names.size(); ++i) {
+        ifstream in(file_names[i], ios::binary);
+        if (!in) {
+            cerr << "can't open " << file_names[i] << endl;
+            return 1;
+        }
+        try {
+            read_game_record_header(in);
+            GameRecord record;
+            while (read_game_record(in, record)) {
+                builder.add_game(record);
+                ++num_games;
+            }
+        } catch (invalid_argument e) {
+            cerr << file_names[i] << ": " << e.what() << endl;
+            return 1;
+        }
+    }
+    try {
+        builder.write(file_names[0], min_games);
+    } catch (runtime_error e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    cerr << "read " << num_games << " games, with " << builder.size() << " different moves in their openings" << endl;
+    return 0;
+}
@@ -0,0 +1,40 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+using std::runtime_error;
+
+MappedFile::MappedFile(const string &file_name) : bytes(nullptr), file_size(0) {
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("can't open " + file_name);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw runtime_error("can't open " + file_name);
+    }
+    file_size = info.st_size;
+    // mmap can't map nothing
+    if (file_size > 0) {
+        void *mapped = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            throw runtime_error("can't map " + file_name + " into memory");
+        }
+        bytes = static_cast<const uint8_t *>(mapped);
+    }
+    // the mapping stays after the file is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (bytes != nullptr) {
+        munmap(const_cast<uint8_t *>(bytes), file_size);
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <cstdint>
+#include <string>
+
+using std::string;
+
+// A whole file mapped into memory (with mmap), read-only. Nothing is read
+// from the disk until it's looked at, and then only the pages that are.
+// Since it can't change, any number of threads can read it at once.
+class MappedFile {
+    const uint8_t *bytes;
+    size_t file_size;
+
+   public:
+    // Throws runtime_error if the file can't be opened or mapped.
+    explicit MappedFile(const string &file_name);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const uint8_t *data() const {
+        return bytes;
+    }
+    size_t size() const {
+        return file_size;
+    }
+};
+
+#endif  // _MAPPED_FILE_H_
@@ -0,0 +1,164 @@
+#include "opening_book.h"
+
+#include <algorithm>
+#include <fstream>
+#include <ios>
+#include <sstream>
+#include <stdexcept>
+
+using std::invalid_argument;
+using std::ios;
+using std::ofstream;
+using std::runtime_error;
+using std::stable_sort;
+using std::stringstream;
+
+static const char MAGIC[4] = {'S', 'C', 'O', 'B'};
+static const uint8_t VERSION = 1;
+static const uint64_t HEADER_SIZE = 16;
+static const uint64_t ENTRY_SIZE = 24;
+
+// Adds the num_bytes lowest bytes of value to bytes, lowest first.
+static void put(string &bytes, uint64_t value, int num_bytes) {
+    for (int i = 0; i < num_bytes; ++i) {
+        bytes += static_cast<char>(value >> (8 * i) & 0xff);
+    }
+}
+
+// Reads a num_bytes little-endian number.
+static uint64_t read_number(const uint8_t *bytes, int num_bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < num_bytes; ++i) {
+        value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+    }
+    return value;
+}
+
+bool BookMove::scores_better_than(const BookMove &other) const {
+    // twice the points is games + wins - losses, which is never negative
+    uint64_t points = uint64_t(games) + wins - losses, other_points = uint64_t(other.games) + other.wins - other.losses;
+    if (points * other.games != other_points * games) {
+        return points * other.games > other_points * games;
+    }
+    return games > other.games;
+}
+
+OpeningBookBuilder::OpeningBookBuilder(int max_moves) : max_moves(max_moves) {}
+
+void OpeningBookBuilder::add_game(const GameRecord &record) {
+    Board board = record.start;
+    for (size_t i = 0; i < record.moves.size() && i < static_cast<size_t>(max_moves); ++i) {
+        Move move = record.moves[i];
+        if (!board.get_legal_moves().is_legal(move)) {
+            stringstream err_msg;
+            err_msg << "game has a move that isn't legal: " << move;
+            throw invalid_argument(err_msg.str());
+        }
+        Team team = board.get_current_teams_turn();
+        uint32_t squares = PackedMove(move).raw() & PackedMove::SQUARES;
+        BookMove &counts = moves.emplace(pair<uint64_t, uint32_t>(board.hash(), squares), BookMove{PackedMove(squares), 0, 0, 0}).first->second;
+        ++counts.games;
+        if (record.winner == team) {
+            ++counts.wins;
+        } else if (record.winner != NONE) {
+            ++counts.losses;
+        }
+        board.make_move(move);
+    }
+}
+
+void OpeningBookBuilder::write(const string &file_name, uint32_t min_games) const {
+    string bytes;
+    uint64_t num_entries = 0;
+    for (const auto &key_and_move : moves) {
+        const BookMove &move = key_and_move.second;
+        if (move.games < min_games) {
+            continue;
+        }
+        put(bytes, key_and_move.first.first, 8);
+        put(bytes, key_and_move.first.second, 4);
+        put(bytes, move.games, 4);
+        put(bytes, move.wins, 4);
+        put(bytes, move.losses, 4);
+        ++num_entries;
+    }
+    string header(MAGIC, sizeof(MAGIC));
+    put(header, VERSION, 1);
+    put(header, 0, 3);
+    put(header, num_entries, 8);
+
+    ofstream file(file_name, ios::binary);
+    file.write(header.data(), header.size());
+    file.write(bytes.data(), bytes.size());
+    file.close();
+    if (!file) {
+        throw runtime_error("couldn't write " + file_name);
+    }
+}
+
+OpeningBook::OpeningBook(const string &file_name) : file(file_name) {
+    const uint8_t *data = file.data();
+    if (file.size() < HEADER_SIZE || string(reinterpret_cast<const char *>(data), sizeof(MAGIC)) != string(MAGIC, sizeof(MAGIC))) {
+        throw invalid_argument(file_name + " isn't an opening book");
+    }
+    if (data[sizeof(MAGIC)] != VERSION) {
+        throw invalid_argument(file_name + " is an opening book of a version this can't read");
+    }
+    num_entries = read_number(data + 8, 8);
+    if ((file.size() - HEADER_SIZE) % ENTRY_SIZE != 0 || (file.size() - HEADER_SIZE) / ENTRY_SIZE != num_entries) {
+        throw invalid_argument(file_name + " is a broken opening book");
+    }
+}
+
+uint64_t OpeningBook::entry_hash(uint64_t index) const {
+    return read_number(file.data() + HEADER_SIZE + index * ENTRY_SIZE, 8);
+}
+
+BookMove OpeningBook::entry(uint64_t index) const {
+    const uint8_t *bytes = file.data() + HEADER_SIZE + index * ENTRY_SIZE;
+    return BookMove{PackedMove(static_cast<uint32_t>(read_number(bytes + 8, 4)) & PackedMove::SQUARES),
+                    static_cast<uint32_t>(read_number(bytes + 12, 4)), static_cast<uint32_t>(read_number(bytes + 16, 4)),
+                    static_cast<uint32_t>(read_number(bytes + 20, 4))};
+}
+
+vector<BookMove> OpeningBook::get_moves(const Board &board) const {
+    uint64_t hash = board.hash();
+    // the first entry for the position (or where it would be)
+    uint64_t first = 0, last = num_entries;
+    while (first < last) {
+        uint64_t middle = first + (last - first) / 2;
+        if (entry_hash(middle) < hash) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    vector<BookMove> found;
+    for (uint64_t index = first; index < num_entries && entry_hash(index) == hash; ++index) {
+        found.push_back(entry(index));
+    }
+    stable_sort(found.begin(), found.end(), [](const BookMove &a, const BookMove &b) { return a.games > b.games; });
+    return found;
+}
+
+bool OpeningBook::choose_move(const Board &board, const MoveList &moves, uint32_t min_games, Move &chosen) const {
+    const BookMove *best = nullptr;
+    vector<BookMove> book_moves = get_moves(board);
+    for (const BookMove &book_move : book_moves) {
+        if (book_move.games < min_games || (best != nullptr && !book_move.scores_better_than(*best))) {
+            continue;
+        }
+        // a different position with the same hash could have a move that isn't legal here
+        for (PackedMove move : moves) {
+            if ((move.raw() & PackedMove::SQUARES) == book_move.move.raw()) {
+                best = &book_move;
+                break;
+            }
+        }
+    }
+    if (best == nullptr) {
+        return false;
+    }
+    chosen = best->move;
+    return true;
+}
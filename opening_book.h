@@ -0,0 +1,93 @@
+#ifndef _OPENING_BOOK_H_
+#define _OPENING_BOOK_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "chess_board.h"
+#include "game_record.h"
+#include "mapped_file.h"
+
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+// How a move has done in the games it was played in, from the point of view
+// of the team that played it.
+struct BookMove {
+    PackedMove move;  // only the squares, no flags
+    uint32_t games;
+    uint32_t wins, losses;  // the rest were draws
+
+    // Whether this move has scored more points per game than other (a win
+    // is 1 point and a draw 1/2), or as many in more games.
+    bool scores_better_than(const BookMove &other) const;
+};
+
+// An opening book file is a header (the 4 bytes "SCOB", a version byte, 3
+// bytes of padding and the number of entries, 8 bytes) and then the entries,
+// sorted by position and then by move, 24 bytes each:
+//   the position's Board::hash (8 bytes)
+//   the move's squares (4 bytes, PackedMove::raw without the flags)
+//   the number of games, wins and losses (4 bytes each)
+// Numbers are little-endian. Being sorted, the moves for a position can be
+// found with a binary search, straight from the file.
+//
+// Positions are only found by their hash, and the hash of a position with
+// custom pieces depends on the order the pieces were made in, so a book
+// with custom pieces only works in programs that make them in the same order.
+
+// Collects the moves played in the opening of lots of games, and how the
+// games ended, and writes them out as an opening book.
+class OpeningBookBuilder {
+    // Only the first this many moves (of either team) of each game count.
+    int max_moves;
+    // by position hash, then the move's squares
+    map<pair<uint64_t, uint32_t>, BookMove> moves;
+
+   public:
+    explicit OpeningBookBuilder(int max_moves = 12);
+
+    // Plays record over again from its start, counting its first max_moves
+    // moves. Throws invalid_argument if one of them isn't legal.
+    void add_game(const GameRecord &record);
+    // How many different positions and moves have been collected.
+    size_t size() const {
+        return moves.size();
+    }
+    // Writes the book to file_name, leaving out the moves that were played
+    // in fewer than min_games games. Throws runtime_error if it can't.
+    void write(const string &file_name, uint32_t min_games = 1) const;
+};
+
+// An opening book file mapped into memory, so opening it doesn't read it in.
+// Looking moves up doesn't change anything, so many threads (or players) can
+// share one.
+class OpeningBook {
+    MappedFile file;
+    uint64_t num_entries;
+
+    BookMove entry(uint64_t index) const;
+    uint64_t entry_hash(uint64_t index) const;
+
+   public:
+    // Throws runtime_error if the file can't be opened, and invalid_argument
+    // if it isn't an opening book (of a version this can read).
+    explicit OpeningBook(const string &file_name);
+
+    uint64_t size() const {
+        return num_entries;
+    }
+    // Every move in the book for board's position, most played first.
+    vector<BookMove> get_moves(const Board &board) const;
+    // The best scoring book move for board that's one of moves, from the
+    // ones played in at least min_games games. Returns false (and leaves
+    // chosen alone) if there isn't one.
+    bool choose_move(const Board &board, const MoveList &moves, uint32_t min_games, Move &chosen) const;
+};
+
+#endif  // _OPENING_BOOK_H_
@@ -0,0 +1,124 @@
+#include "perft.h"
+
+#include <atomic>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "chess_board.h"
+
+using std::atomic;
+using std::getline;
+using std::invalid_argument;
+using std::istream;
+using std::istringstream;
+using std::pair;
+using std::string;
+using std::thread;
+using std::vector;
+
+uint64_t perft(Board &board, int depth) {
+    if (depth == 0) {
+        return 1;
+    }
+    if (board.winner() != NONE) {
+        return 0;
+    }
+    MoveList moves = board.get_moves();
+    if (depth == 1) {
+        return moves.size();  // no need to make the moves just to count them
+    }
+    uint64_t count = 0;
+    for (Move move : moves) {
+        board.make_move(move);
+        count += perft(board, depth - 1);
+        board.unmake_move();
+    }
+    return count;
+}
+
+vector<pair<Move, uint64_t>> perft_divide(const Board &board, int depth, int num_threads) {
+    vector<pair<Move, uint64_t>> counts;
+    if (depth == 0 || board.winner() != NONE) {
+        return counts;
+    }
+    for (Move move : board.get_moves()) {
+        counts.emplace_back(move, 0);
+    }
+
+    // each thread takes the next move nobody has counted yet
+    atomic<size_t> next_move(0);
+    auto count_moves = [&]() {
+        Board copy = board;
+        for (size_t i = next_move++; i < counts.size(); i = next_move++) {
+            copy.make_move(counts[i].first);
+            counts[i].second = perft(copy, depth - 1);
+            copy.unmake_move();
+        }
+    };
+    vector<thread> threads;
+    for (int i = 1; i < num_threads; ++i) {
+        threads.emplace_back(count_moves);
+    }
+    count_moves();
+    for (thread &t : threads) {
+        t.join();
+    }
+    return counts;
+}
+
+vector<PerftPosition> read_perft_suite(istream &is) {
+    vector<PerftPosition> positions;
+    string line;
+    while (getline(is, line)) {
+        istringstream words(line);
+        string word;
+        if (!(words >> word) || word[0] == '#') {
+            continue;  // blank line or comment
+        }
+
+        if (word == "position") {
+            positions.emplace_back();
+            getline(words >> std::ws, positions.back().name);
+        } else if (positions.empty()) {
+            throw invalid_argument("read_perft_suite: expected a position before: " + line);
+        } else if (word == "turn") {
+            string team;
+            words >> team;
+            if (team != "White" && team != "Black") {
+                throw invalid_argument("read_perft_suite: unknown team: " + line);
+            }
+            positions.back().board.set_current_teams_turn(team == "White" ? WHITE : BLACK);
+        } else if (word == "size") {
+            // a board of this size, set up the usual way
+            size_t width, height;
+            if (!(words >> width >> height) || width < 2 || width > 26 || height < 2 || height > 99) {
+                throw invalid_argument("read_perft_suite: expected a width (2-26) and a height (2-99): " + line);
+            }
+            Team turn = positions.back().board.get_current_teams_turn();
+            positions.back().board = Board(width, height);
+            positions.back().board.set_current_teams_turn(turn);
+        } else if (word == "board") {
+            // the board is on the lines after this one
+            Team turn = positions.back().board.get_current_teams_turn();
+            if (!(is >> positions.back().board)) {
+                throw invalid_argument("read_perft_suite: expected a board 2-26 squares wide and 2-99 high after: " + line);
+            }
+            positions.back().board.set_current_teams_turn(turn);
+        } else if (word == "perft") {
+            int depth;
+            uint64_t count;
+            if (!(words >> depth >> count)) {
+                throw invalid_argument("read_perft_suite: expected a depth and a count: " + line);
+            }
+            positions.back().counts.emplace_back(depth, count);
+        } else {
+            throw invalid_argument("read_perft_suite: don't know what this means: " + line);
+        }
+    }
+    return positions;
+}
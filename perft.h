@@ -0,0 +1,40 @@
+#ifndef _PERFT_H_
+#define _PERFT_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "chess_board.h"
+
+using std::istream;
+using std::pair;
+using std::string;
+using std::vector;
+
+// Perft ("performance test") counts the positions reached by playing every
+// possible sequence of depth moves. Comparing the counts with known ones is
+// a very thorough check of move generation (and make/unmake_move), and how
+// fast they're counted is a good measure of how fast move generation is.
+// A position where somebody has already won has no moves.
+
+// The number of positions depth moves after board. board ends up the way it started.
+uint64_t perft(Board &board, int depth);
+
+// The perft of each move from board (to depth - 1 after it), in the order
+// get_moves gives them. The moves are split between num_threads threads.
+vector<pair<Move, uint64_t>> perft_divide(const Board &board, int depth, int num_threads);
+
+// A position with its known perft counts.
+struct PerftPosition {
+    string name;
+    Board board;
+    vector<pair<int, uint64_t>> counts;  // (depth, number of positions)
+};
+
+// Reads a suite of positions (see perft_suite.txt for the format).
+vector<PerftPosition> read_perft_suite(istream &is);
+
+#endif  // _PERFT_H_
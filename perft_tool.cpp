@@ -0,0 +1,121 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "chess_board.h"
+#include "chess_pieces.h"
+#include "perft.h"
+
+using namespace std;
+
+// Counts positions with perft (see perft.h).
+//
+// usage:
+//   perft [options] depth [board file]
+//     Counts the positions depth moves after the board in the file (or the
+//     starting board), with the count after each first move.
+//   perft [options] --suite perft_suite.txt [max depth]
+//     Checks every count in the suite (up to max depth) and exits with 1 if
+//     any of them are wrong.
+// options:
+//   --threads N   split the first moves between N threads (default: all cores)
+//   --black       it's black's turn on the board from the file
+
+double seconds_since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Counts the positions depth moves after board, and says how fast that was.
+uint64_t count_positions(const Board &board, int depth, int num_threads, bool divide) {
+    auto start = chrono::steady_clock::now();
+    uint64_t total = 0;
+    for (const pair<Move, uint64_t> &count : perft_divide(board, depth, num_threads)) {
+        if (divide) {
+            cout << count.first << ": " << count.second << '\n';
+        }
+        total += count.second;
+    }
+    if (depth == 0) {
+        total = 1;
+    }
+    double seconds = seconds_since(start);
+    cout << "depth " << depth << ": " << total << " positions in " << seconds << "s ("
+         << static_cast<uint64_t>(total / (seconds > 0 ? seconds : 1e-9)) << " positions/s)" << endl;
+    return total;
+}
+
+int run_suite(const char *file_name, int max_depth, int num_threads) {
+    ifstream in(file_name);
+    if (!in) {
+        cerr << "can't open " << file_name << endl;
+        return 1;
+    }
+    int num_wrong = 0;
+    for (const PerftPosition &position : read_perft_suite(in)) {
+        cout << position.name << endl;
+        for (const pair<int, uint64_t> &expected : position.counts) {
+            if (max_depth >= 0 && expected.first > max_depth) {
+                continue;
+            }
+            uint64_t count = count_positions(position.board, expected.first, num_threads, false);
+            if (count != expected.second) {
+                cout << "  WRONG: expected " << expected.second << endl;
+                ++num_wrong;
+            }
+        }
+    }
+    cout << (num_wrong == 0 ? "all counts are right" : "some counts are wrong") << endl;
+    return num_wrong == 0 ? 0 : 1;
+}
+
+int main(int argc, const char *argv[]) {
+    int num_threads = thread::hardware_concurrency();
+    bool black_to_move = false;
+    const char *suite = nullptr;
+    vector<const char *> args;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--black") == 0) {
+            black_to_move = true;
+        } else if (strcmp(argv[i], "--suite") == 0 && i + 1 < argc) {
+            suite = argv[++i];
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+
+    if (suite != nullptr) {
+        return run_suite(suite, args.empty() ? -1 : atoi(args[0]), num_threads);
+    }
+    if (args.empty()) {
+        cerr << "usage: perft [--threads N] [--black] depth [board file]\n"
+             << "       perft [--threads N] --suite perft_suite.txt [max depth]" << endl;
+        return 1;
+    }
+
+    Board board;
+    if (args.size() > 1) {
+        ifstream in(args[1]);
+        if (!in) {
+            cerr << "can't open " << args[1] << endl;
+            return 1;
+        }
+        if (!(in >> board)) {
+            cerr << args[1] << " isn't a board 2-26 squares wide and 2-99 high" << endl;
+            return 1;
+        }
+    }
+    board.set_current_teams_turn(black_to_move ? BLACK : WHITE);
+    count_positions(board, atoi(args[0]), num_threads, true);
+    return 0;
+}
@@ -0,0 +1,318 @@
+#include "position_database.h"
+
+#include <atomic>
+#include <exception>
+#include <ios>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "bitboard.h"
+#include "chess_pieces.h"
+#include "position_notation.h"
+
+using std::atomic;
+using std::exception_ptr;
+using std::getline;
+using std::invalid_argument;
+using std::istringstream;
+using std::ios;
+using std::out_of_range;
+using std::runtime_error;
+using std::thread;
+using std::to_string;
+
+static const char MAGIC[4] = {'S', 'C', 'P', 'D'};
+static const uint8_t VERSION = 1;
+static const uint64_t HEADER_SIZE = 24;
+
+// Adds the num_bytes lowest bytes of value to bytes, lowest first.
+static void put(string &bytes, uint64_t value, int num_bytes) {
+    for (int i = 0; i < num_bytes; ++i) {
+        bytes += static_cast<char>(value >> (8 * i) & 0xff);
+    }
+}
+
+// Reads a num_bytes little-endian number.
+static uint64_t read_number(const uint8_t *bytes, int num_bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < num_bytes; ++i) {
+        value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+    }
+    return value;
+}
+
+static uint64_t round_up_to_8(uint64_t size) {
+    return (size + 7) / 8 * 8;
+}
+
+PositionDatabaseWriter::PositionDatabaseWriter(const string &file_name) : file(file_name, ios::binary), size(HEADER_SIZE) {
+    if (!file) {
+        throw runtime_error("can't open " + file_name + " for writing");
+    }
+    for (int &index : index_by_code) {
+        index = -1;
+    }
+    // filled in by close, once it's known what goes in it
+    string header(HEADER_SIZE, '\0');
+    file.write(header.data(), header.size());
+}
+
+PositionDatabaseWriter::~PositionDatabaseWriter() {
+    try {
+        close();
+    } catch (runtime_error e) {
+        // nobody to tell
+    }
+}
+
+void PositionDatabaseWriter::add(const Board &board) {
+    int width = board.get_width(), height = board.get_height();
+    bytes.clear();
+    put(bytes, width, 1);
+    put(bytes, height, 1);
+    put(bytes, board.get_current_teams_turn(), 1);
+    size_t occupied = bytes.size();
+    bytes.append((width * height + 7) / 8, '\0');
+    for (int y = 0; y < height; ++y) {
+        int index = board.square_index(Cell(0, y));
+        for (int x = 0; x < width; ++x) {
+            uint8_t code = board.code_at(index + x);
+            if (code == ChessPiece::EMPTY_CODE) {
+                continue;
+            }
+            int square = y * width + x;
+            bytes[occupied + square / 8] |= 1 << square % 8;
+            if (index_by_code[code] < 0) {
+                index_by_code[code] = code_points.size();
+                code_points.push_back(ChessPiece::piece_by_code[code]->utf8_codepoint);
+            }
+            bytes += static_cast<char>(index_by_code[code]);
+        }
+    }
+    file.write(bytes.data(), bytes.size());
+    offsets.push_back(size);
+    size += bytes.size();
+}
+
+void PositionDatabaseWriter::close() {
+    if (!file.is_open()) {
+        return;
+    }
+    uint64_t tables_offset = round_up_to_8(size);
+    string tables;
+    put(tables, code_points.size(), 1);
+    for (char32_t code_point : code_points) {
+        put(tables, code_point, 4);
+    }
+    tables.append(round_up_to_8(tables.size()) - tables.size(), '\0');
+    tables.insert(0, tables_offset - size, '\0');
+    offsets.push_back(size);
+    for (uint64_t offset : offsets) {
+        put(tables, offset, 8);
+    }
+    file.write(tables.data(), tables.size());
+
+    string header(MAGIC, sizeof(MAGIC));
+    put(header, VERSION, 1);
+    put(header, 0, 3);
+    put(header, offsets.size() - 1, 8);
+    put(header, tables_offset, 8);
+    file.seekp(0);
+    file.write(header.data(), header.size());
+    file.close();
+    if (!file) {
+        throw runtime_error("couldn't write the position database");
+    }
+}
+
+PositionDatabase::PositionDatabase(const string &file_name) : file(file_name) {
+    const uint8_t *data = file.data();
+    size_t file_size = file.size();
+    if (file_size < HEADER_SIZE || string(reinterpret_cast<const char *>(data), sizeof(MAGIC)) != string(MAGIC, sizeof(MAGIC))) {
+        throw invalid_argument(file_name + " isn't a position database");
+    }
+    if (data[sizeof(MAGIC)] != VERSION) {
+        throw invalid_argument(file_name + " is a position database of a version this can't read");
+    }
+    num_positions = read_number(data + 8, 8);
+    tables_offset = read_number(data + 16, 8);
+    if (tables_offset % 8 != 0 || tables_offset >= file_size) {
+        throw invalid_argument(file_name + " is a broken position database");
+    }
+    const uint8_t *tables = data + tables_offset;
+    int num_pieces = tables[0];
+    uint64_t pieces_size = round_up_to_8(1 + 4 * num_pieces);
+    // the offsets table has one more entry than there are positions, so it
+    // can't be empty (and num_positions + 1 could wrap around)
+    if (file_size - tables_offset < pieces_size + 8 || (file_size - tables_offset - pieces_size) % 8 != 0 ||
+        num_positions != (file_size - tables_offset - pieces_size) / 8 - 1) {
+        throw invalid_argument(file_name + " is a broken position database");
+    }
+    codes.resize(num_pieces);
+    for (int i = 0; i < num_pieces; ++i) {
+        const ChessPiece *piece = ChessPiece::with_code_point(read_number(tables + 1 + 4 * i, 4));
+        if (piece == nullptr || piece->code == ChessPiece::EMPTY_CODE) {
+            throw invalid_argument(file_name + " has a piece that doesn't exist");
+        }
+        codes[i] = piece->code;
+    }
+    offsets = tables + pieces_size;
+}
+
+void PositionDatabase::get(uint64_t index, Board &board) const {
+    if (index >= num_positions) {
+        throw out_of_range("there's no position " + to_string(index) + " in a database of " + to_string(num_positions));
+    }
+    uint64_t start = read_number(offsets + 8 * index, 8), end = read_number(offsets + 8 * (index + 1), 8);
+    if (start < HEADER_SIZE || start > end || end > tables_offset || end - start < 3) {
+        throw invalid_argument("position " + to_string(index) + " is broken");
+    }
+    const uint8_t *position = file.data() + start;
+    size_t width = position[0], height = position[1];
+    Team turn = static_cast<Team>(position[2]);
+    size_t occupied_size = (width * height + 7) / 8;
+    if (width < 2 || width > 26 || height < 2 || height > 99 || (turn != NONE && turn != BLACK && turn != WHITE) ||
+        end - start < 3 + occupied_size) {
+        throw invalid_argument("position " + to_string(index) + " is broken");
+    }
+    const uint8_t *occupied = position + 3;
+    const uint8_t *pieces = occupied + occupied_size;
+    const uint8_t *pieces_end = file.data() + end;
+
+    board.width = width;
+    board.height = height;
+    board.resize_board();
+    for (size_t byte = 0; byte < occupied_size; ++byte) {
+        uint64_t bits = occupied[byte];
+        while (bits != 0) {
+            size_t square = byte * 8 + lowest_bit(bits);
+            bits &= bits - 1;
+            if (square >= width * height || pieces == pieces_end || *pieces >= codes.size()) {
+                throw invalid_argument("position " + to_string(index) + " is broken");
+            }
+            board.set_square(Cell(square % width, square / width), codes[*pieces]);
+            ++pieces;
+        }
+    }
+    if (pieces != pieces_end) {
+        throw invalid_argument("position " + to_string(index) + " is broken");
+    }
+    board.set_turn(turn);
+}
+
+Board PositionDatabase::operator[](uint64_t index) const {
+    Board board;
+    get(index, board);
+    return board;
+}
+
+void PositionDatabase::for_each(int num_threads, const function<void(uint64_t index, const Board &board)> &visit) const {
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    vector<exception_ptr> errors(num_threads);
+    atomic<bool> stopping(false);
+    vector<thread> threads;
+    for (int i = 0; i < num_threads; ++i) {
+        threads.emplace_back([&, i]() {
+            uint64_t first = num_positions * i / num_threads, last = num_positions * (i + 1) / num_threads;
+            Board board;
+            try {
+                for (uint64_t index = first; index < last && !stopping; ++index) {
+                    get(index, board);
+                    visit(index, board);
+                }
+            } catch (...) {
+                errors[i] = std::current_exception();
+                stopping = true;
+            }
+        });
+    }
+    for (thread &t : threads) {
+        t.join();
+    }
+    for (const exception_ptr &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+uint64_t convert_text_positions(istream &is, PositionDatabaseWriter &writer) {
+    uint64_t num_positions = 0;
+    Board board;
+    bool have_board = false;  // board hasn't been added yet, in case its turn comes next
+    string line;
+    while (getline(is, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+        Team turn = NONE;
+        bool is_turn = false;
+        for (Team team : {NONE, BLACK, WHITE}) {
+            if (line == string(team_name(team)) + "'s turn.") {
+                turn = team;
+                is_turn = true;
+            }
+        }
+        if (is_turn) {
+            if (have_board) {
+                board.set_current_teams_turn(turn);
+            }
+            continue;
+        }
+        if (have_board) {
+            writer.add(board);
+            ++num_positions;
+            have_board = false;
+        }
+
+        if (line.compare(0, 3, "   ") == 0 && line.size() > 3) {
+            // a board goes on until the letters of the files come again
+            string text = line + '\n';
+            while (getline(is, line)) {
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                text += line + '\n';
+                if (line.compare(0, 3, "   ") == 0) {
+                    break;
+                }
+            }
+            // Other indented text, boards of a size there can't be and boards
+            // with pieces that don't exist are skipped, and so is anything
+            // that doesn't come out the same when the board is written back.
+            istringstream in(text);
+            try {
+                if (in >> board) {
+                    string written;
+                    write_board(board, written);
+                    have_board = written == text;
+                }
+            } catch (invalid_argument e) {
+                // a size there can't be
+            } catch (out_of_range e) {
+                // a piece that doesn't exist
+            }
+            if (have_board) {
+                board.set_current_teams_turn(WHITE);
+            }
+        } else {
+            try {
+                read_position(line, board);
+                have_board = true;
+            } catch (invalid_argument e) {
+                // not a position
+            }
+        }
+    }
+    if (have_board) {
+        writer.add(board);
+        ++num_positions;
+    }
+    return num_positions;
+}
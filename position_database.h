@@ -0,0 +1,111 @@
+#ifndef _POSITION_DATABASE_H_
+#define _POSITION_DATABASE_H_
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "chess_board.h"
+#include "mapped_file.h"
+
+using std::function;
+using std::istream;
+using std::string;
+using std::vector;
+
+// A file of positions that can be opened without reading it in, and looked
+// up by number. It's laid out as:
+//   a header: the 4 bytes "SCPD", a version byte, 3 bytes of padding, the
+//     number of positions (8 bytes) and where the tables are (8 bytes)
+//   the positions one after another, each one:
+//     the width, height and whose turn it is (1 byte each, a Team)
+//     which squares have a piece on them, 1 bit each in the order
+//       y * width + x (rounded up to a whole byte)
+//     for each of those squares, which piece it is (1 byte, an index into
+//       the list of pieces)
+//   the tables, 8-byte aligned:
+//     the list of pieces: how many there are (1 byte) and each one's code
+//       point (4 bytes), then padding up to a multiple of 8
+//     where each position starts (8 bytes each), and then where the last
+//       one ends (so that where each position ends is known too)
+// Numbers are little-endian. An 8 by 8 starting position takes 43 bytes
+// plus 8 for its index entry.
+
+// Writes a position database. Nothing can be read from the file until the
+// writer has been closed (or destroyed).
+class PositionDatabaseWriter {
+    std::ofstream file;
+    // Where the positions got to, and where each one starts.
+    uint64_t size;
+    vector<uint64_t> offsets;
+    // The list of pieces so far, and each code's index in it (-1 if it
+    // isn't in it yet).
+    vector<char32_t> code_points;
+    int index_by_code[256];
+    // Reused by add, so that adding a position doesn't allocate.
+    string bytes;
+
+   public:
+    // Throws runtime_error if the file can't be opened.
+    explicit PositionDatabaseWriter(const string &file_name);
+    ~PositionDatabaseWriter();
+
+    PositionDatabaseWriter(const PositionDatabaseWriter &) = delete;
+    PositionDatabaseWriter &operator=(const PositionDatabaseWriter &) = delete;
+
+    void add(const Board &board);
+    // Writes the tables and the header. Throws runtime_error if they can't
+    // be written.
+    void close();
+};
+
+// A position database mapped into memory (with mmap), so opening it doesn't
+// read anything and only the positions that are looked at are ever read
+// from the disk. Looking positions up doesn't change anything, so any
+// number of threads can do it at once.
+class PositionDatabase {
+    MappedFile file;
+    uint64_t num_positions;
+    // Where the offsets of the positions start.
+    const uint8_t *offsets;
+    uint64_t tables_offset;
+    // The pieces' codes, by their index in the list of pieces.
+    vector<uint8_t> codes;
+
+   public:
+    // Throws runtime_error if the file can't be opened or mapped, and
+    // invalid_argument if it isn't a position database (of a version this
+    // can read).
+    explicit PositionDatabase(const string &file_name);
+
+    uint64_t size() const {
+        return num_positions;
+    }
+    // Sets board to the indexth position, straight from the file and reusing
+    // board's memory. Like reading a board in, this forgets the moves made so
+    // far. Throws out_of_range if there's no such position and
+    // invalid_argument if it's broken.
+    void get(uint64_t index, Board &board) const;
+    Board operator[](uint64_t index) const;
+
+    // Calls visit with every position (and its index) from num_threads
+    // threads, each going through its own share of them on its own board.
+    // If visit (or reading a position) throws, every thread stops and the
+    // exception is thrown again from here (one of them, if more than one
+    // thread threw).
+    void for_each(int num_threads, const function<void(uint64_t index, const Board &board)> &visit) const;
+};
+
+// Adds every position in is to writer, and returns how many there were. A
+// position is either a board the way operator<< writes it (whose turn it is
+// can be on the line after it, the way game logs have it: "Black's turn.")
+// or a line in position notation (see position_notation.h). Every other
+// line is skipped, so a game log written at LOG_BOARDS can be converted too,
+// and so is any board that can't be read or doesn't come out the same when
+// it's written back.
+uint64_t convert_text_positions(istream &is, PositionDatabaseWriter &writer);
+
+#endif  // _POSITION_DATABASE_H_
@@ -0,0 +1,67 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "chess_board.h"
+#include "position_database.h"
+#include "position_notation.h"
+
+using namespace std;
+
+// Makes and reads position databases (see position_database.h).
+//
+// usage:
+//   position_db convert TEXT_FILE DATABASE   makes a database of the
+//                                            positions in TEXT_FILE (boards,
+//                                            or lines in position notation)
+//   position_db show DATABASE [N]            writes every position (or just
+//                                            the Nth, counting from 0) in
+//                                            position notation
+// Exits with 1 if a file can't be read or written, or isn't what it should be.
+
+int main(int argc, const char *argv[]) {
+    try {
+        if (argc == 4 && strcmp(argv[1], "convert") == 0) {
+            ifstream in(argv[2]);
+            if (!in) {
+                cerr << "can't open " << argv[2] << endl;
+                return 1;
+            }
+            uint64_t num_positions;
+            {
+                PositionDatabaseWriter writer(argv[3]);
+                num_positions = convert_text_positions(in, writer);
+                writer.close();
+            }
+            cerr << "wrote " << num_positions << " positions to " << argv[3] << endl;
+            return 0;
+        }
+        if ((argc == 3 || argc == 4) && strcmp(argv[1], "show") == 0) {
+            PositionDatabase database(argv[2]);
+            uint64_t first = 0, last = database.size();
+            if (argc == 4) {
+                first = strtoull(argv[3], nullptr, 10);
+                last = first + 1;
+            }
+            Board board;
+            string text;
+            for (uint64_t index = first; index < last; ++index) {
+                database.get(index, board);
+                text.clear();
+                write_position(board, text);
+                text += '\n';
+                cout.write(text.data(), text.size());
+            }
+            return 0;
+        }
+    } catch (exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    cerr << "usage: position_db convert TEXT_FILE DATABASE\n"
+         << "       position_db show DATABASE [N]" << endl;
+    return 1;
+}
@@ -0,0 +1,198 @@
+#include "position_notation.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "chess_pieces.h"
+
+using std::invalid_argument;
+using std::pair;
+using std::to_string;
+
+static const size_t MAX_WIDTH = 26, MAX_HEIGHT = 99;
+
+// Which piece each letter stands for, and the other way around (0 for
+// pieces without a letter), so that neither reading nor writing has to
+// search for anything.
+struct PieceLetters {
+    const ChessPiece *piece_by_letter[128] = {};
+    char letter_by_code[256] = {};
+
+    PieceLetters() {
+        const pair<char, const ChessPiece *> letters[] = {
+            {'K', &WHITE_KING}, {'Q', &WHITE_QUEEN}, {'B', &WHITE_BISHOP}, {'N', &WHITE_KNIGHT},
+            {'R', &WHITE_ROOK}, {'P', &WHITE_PAWN}, {'C', &WHITE_CANNON}, {'T', &WHITE_BOMBTOWER},
+            {'k', &BLACK_KING}, {'q', &BLACK_QUEEN}, {'b', &BLACK_BISHOP}, {'n', &BLACK_KNIGHT},
+            {'r', &BLACK_ROOK}, {'p', &BLACK_PAWN}, {'c', &BLACK_CANNON}, {'t', &BLACK_BOMBTOWER},
+        };
+        for (const auto &letter_and_piece : letters) {
+            piece_by_letter[static_cast<int>(letter_and_piece.first)] = letter_and_piece.second;
+            letter_by_code[letter_and_piece.second->code] = letter_and_piece.first;
+        }
+    }
+};
+
+// Made the first time it's needed, since the pieces are globals in another
+// file and might not have been constructed yet before main.
+static const PieceLetters &piece_letters() {
+    static const PieceLetters letters;
+    return letters;
+}
+
+static void fail(const string &problem, size_t at) {
+    throw invalid_argument("bad position at character " + to_string(at) + ": " + problem);
+}
+
+void write_position(const Board &board, string &text) {
+    const PieceLetters &letters = piece_letters();
+    int width = board.get_width(), height = board.get_height();
+    for (int y = height - 1; y >= 0; --y) {
+        int index = board.square_index(Cell(0, y));
+        int empty = 0;
+        for (int x = 0; x <= width; ++x) {
+            uint8_t code = x < width ? board.code_at(index + x) : ChessPiece::OFF_BOARD;
+            if (code == ChessPiece::EMPTY_CODE) {
+                ++empty;
+                continue;
+            }
+            if (empty >= 10) {
+                text += static_cast<char>('0' + empty / 10);
+            }
+            if (empty > 0) {
+                text += static_cast<char>('0' + empty % 10);
+                empty = 0;
+            }
+            if (x == width) {
+                break;
+            }
+            if (letters.letter_by_code[code] != 0) {
+                text += letters.letter_by_code[code];
+            } else {
+                append_utf8(text, ChessPiece::piece_by_code[code]->utf8_codepoint);
+            }
+        }
+        if (y > 0) {
+            text += '/';
+        }
+    }
+    Team turn = board.get_current_teams_turn();
+    text += ' ';
+    text += turn == WHITE ? 'w' : turn == BLACK ? 'b' : '-';
+}
+
+string write_position(const Board &board) {
+    string text;
+    write_position(board, text);
+    return text;
+}
+
+void read_position(string_view text, Board &board) {
+    const PieceLetters &letters = piece_letters();
+    // Every square's code, top rank first, MAX_WIDTH to a rank. The board
+    // isn't touched until the whole position has been read.
+    uint8_t codes[MAX_WIDTH * MAX_HEIGHT];
+    size_t width = 0, height = 0, x = 0;
+    size_t i = 0;
+    while (true) {
+        if (i == text.size()) {
+            fail("it ends before saying whose turn it is", i);
+        }
+        char c = text[i];
+        if (c == '/' || c == ' ') {
+            if (height == 0) {
+                width = x;
+                if (width < 2) {
+                    fail("the board has to be at least 2 squares wide", i);
+                }
+            } else if (x != width) {
+                fail("this rank isn't as wide as the first one", i);
+            }
+            ++height;
+            ++i;
+            if (c == ' ') {
+                break;
+            }
+            if (height == MAX_HEIGHT) {
+                fail("the board can't be more than 99 squares high", i);
+            }
+            x = 0;
+        } else if (c >= '0' && c <= '9') {
+            size_t start = i;
+            size_t run = 0;
+            while (i < text.size() && text[i] >= '0' && text[i] <= '9' && run <= MAX_WIDTH) {
+                run = run * 10 + (text[i] - '0');
+                ++i;
+            }
+            if (run == 0) {
+                fail("0 empty squares", start);
+            }
+            if (x + run > MAX_WIDTH) {
+                fail("the board can't be more than 26 squares wide", start);
+            }
+            memset(codes + height * MAX_WIDTH + x, ChessPiece::EMPTY_CODE, run);
+            x += run;
+        } else {
+            const ChessPiece *piece = nullptr;
+            size_t length = 1;
+            if (static_cast<unsigned char>(c) < 128) {
+                piece = letters.piece_by_letter[static_cast<int>(c)];
+            } else {
+                char32_t code_point;
+                length = decode_utf8(text.data() + i, text.size() - i, code_point);
+                // pieces without a letter, which are rare enough not to need a table
+                if (length != 0) {
+                    piece = ChessPiece::with_code_point(code_point);
+                }
+            }
+            if (piece == nullptr) {
+                fail("not a piece", i);
+            }
+            if (x == MAX_WIDTH) {
+                fail("the board can't be more than 26 squares wide", i);
+            }
+            codes[height * MAX_WIDTH + x] = piece->code;
+            ++x;
+            i += length;
+        }
+    }
+    if (height < 2) {
+        fail("the board has to be at least 2 squares high", i);
+    }
+
+    Team turn = NONE;
+    if (i == text.size()) {
+        fail("it doesn't say whose turn it is", i);
+    } else if (text[i] == 'w') {
+        turn = WHITE;
+    } else if (text[i] == 'b') {
+        turn = BLACK;
+    } else if (text[i] == '-') {
+        turn = NONE;
+    } else {
+        fail("whose turn it is has to be w, b or -", i);
+    }
+    if (i + 1 != text.size()) {
+        fail("there's more after whose turn it is", i + 1);
+    }
+
+    board.width = width;
+    board.height = height;
+    board.resize_board();
+    for (size_t row = 0; row < height; ++row) {
+        for (size_t col = 0; col < width; ++col) {
+            uint8_t code = codes[row * MAX_WIDTH + col];
+            if (code != ChessPiece::EMPTY_CODE) {
+                board.set_square(Cell(col, height - 1 - row), code);
+            }
+        }
+    }
+    board.set_turn(turn);
+}
+
+Board read_position(string_view text) {
+    Board board;
+    read_position(text, board);
+    return board;
+}
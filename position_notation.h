@@ -0,0 +1,34 @@
+#ifndef _POSITION_NOTATION_H_
+#define _POSITION_NOTATION_H_
+
+#include <string>
+#include <string_view>
+
+#include "chess_board.h"
+
+using std::string;
+using std::string_view;
+
+// A position on one line, like FEN:
+//   rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w
+// The ranks go from the top of the board (black's side) to the bottom, split
+// up by '/'. Each piece is a letter, upper case for white and lower case for
+// black: K king, Q queen, B bishop, N knight, R rook, P pawn, C cannon and T
+// bomb tower. Any other piece is written as its own character (which can be
+// read for the pieces with letters too). A number is that many empty squares
+// in a row. Every rank has to be the same width (2 to 26 squares), and there
+// can be 2 to 99 of them. After a space comes whose turn it is: w (white),
+// b (black) or - (nobody's).
+
+// Adds board's position to the end of text, with no newline.
+void write_position(const Board &board, string &text);
+string write_position(const Board &board);
+
+// Sets board to the position in text (which must be exactly one position,
+// with nothing before or after it), reusing board's memory. Like reading a
+// board in, this forgets the moves made so far. Throws invalid_argument if
+// text isn't a position, in which case board is left as it was.
+void read_position(string_view text, Board &board);
+Board read_position(string_view text);
+
+#endif  // _POSITION_NOTATION_H_
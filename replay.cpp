@@ -0,0 +1,75 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "chess_board.h"
+#include "game_record.h"
+
+using namespace std;
+
+// Reads a file of game records (see game_record.h) and plays the games over
+// again, writing them out as text.
+//
+// usage: replay [options] FILE
+//   --level LEVEL   how much of each game to write: results, moves or
+//                   boards (the default)
+//   --game N        only write the Nth game (counting from 1)
+// Exits with 1 if the file isn't a file of game records, or one of the games
+// in it has a move that isn't legal.
+
+int main(int argc, const char *argv[]) {
+    LogLevel level = LOG_BOARDS;
+    uint64_t only_game = 0;
+    const char *file_name = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+            string name = argv[++i];
+            if (name == "results") {
+                level = LOG_RESULTS;
+            } else if (name == "moves") {
+                level = LOG_MOVES;
+            } else if (name == "boards") {
+                level = LOG_BOARDS;
+            } else {
+                cerr << "--level must be results, moves or boards" << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--game") == 0 && i + 1 < argc) {
+            only_game = strtoull(argv[++i], nullptr, 10);
+        } else {
+            file_name = argv[i];
+        }
+    }
+    if (file_name == nullptr) {
+        cerr << "usage: replay [--level results|moves|boards] [--game N] FILE" << endl;
+        return 1;
+    }
+
+    ifstream in(file_name, ios::binary);
+    if (!in) {
+        cerr << "can't open " << file_name << endl;
+        return 1;
+    }
+    uint64_t game = 0;
+    try {
+        read_game_record_header(in);
+        GameRecord record;
+        while (read_game_record(in, record)) {
+            ++game;
+            if (only_game != 0 && game != only_game) {
+                continue;
+            }
+            cout << "game " << game << ":\n";
+            write_game_text(cout, record, level);
+            cout << '\n';
+        }
+    } catch (invalid_argument e) {
+        cout << flush;
+        cerr << "game " << game << ": " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
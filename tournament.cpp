@@ -0,0 +1,132 @@
+#include "tournament.h"
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "chess_board.h"
+#include "chess_player.h"
+
+using std::atomic;
+using std::memory_order_relaxed;
+using std::seed_seq;
+using std::thread;
+using std::vector;
+
+Team play_game(Player &white_player, Player &black_player, int max_moves, GameRecord *record) {
+    Board board;
+    if (record != nullptr) {
+        record->start = board;
+        record->white_player = white_player.kind();
+        record->black_player = black_player.kind();
+        record->moves.clear();
+    }
+    for (int i = 0; i < max_moves && board.winner() == NONE; ++i) {
+        Player &player = board.get_current_teams_turn() == WHITE ? white_player : black_player;
+        LegalMoves moves = board.get_legal_moves();
+        Move move = player.get_move(board, moves.get_moves());
+        if (!moves.is_legal(move)) {
+            // asking again could go on forever, so whoever tried it loses
+            Team winner = player.team == WHITE ? BLACK : WHITE;
+            if (record != nullptr) {
+                record->winner = winner;
+            }
+            return winner;
+        }
+        if (record != nullptr) {
+            record->moves.push_back(move);
+        }
+        board.make_move(move);
+    }
+    if (record != nullptr) {
+        record->winner = board.winner();
+    }
+    return board.winner();
+}
+
+Tournament::Tournament(PlayerMaker make_white_player, PlayerMaker make_black_player, int num_threads, unsigned seed, int max_moves, GameRecorder record_game)
+    : make_white_player(make_white_player),
+      make_black_player(make_black_player),
+      num_threads(num_threads < 1 ? 1 : num_threads),
+      seed(seed),
+      max_moves(max_moves),
+      record_game(record_game) {}
+
+GameCounts Tournament::run(uint64_t num_games, uint64_t report_every, function<void(const GameCounts &)> report) const {
+    // Threads count their games themselves and only add them to the totals
+    // every BATCH_SIZE games, so they hardly ever touch the shared counters.
+    const uint64_t BATCH_SIZE = 16;
+    atomic<uint64_t> next_game(0);
+    atomic<uint64_t> white_wins(0), black_wins(0), draws(0);
+    atomic<int> threads_running(num_threads);
+
+    vector<thread> threads;
+    for (int i = 0; i < num_threads; ++i) {
+        threads.emplace_back([&, i]() {
+            seed_seq seeds{seed, static_cast<unsigned>(i)};
+            unsigned player_seeds[2];
+            seeds.generate(player_seeds, player_seeds + 2);
+            unique_ptr<Player> white_player = make_white_player(WHITE, player_seeds[0]);
+            unique_ptr<Player> black_player = make_black_player(BLACK, player_seeds[1]);
+
+            GameRecord record;
+            GameCounts batch;
+            auto add_batch = [&]() {
+                white_wins.fetch_add(batch.white_wins, memory_order_relaxed);
+                black_wins.fetch_add(batch.black_wins, memory_order_relaxed);
+                draws.fetch_add(batch.draws, memory_order_relaxed);
+                batch = GameCounts();
+            };
+            while (next_game.fetch_add(1, memory_order_relaxed) < num_games) {
+                Team winner = play_game(*white_player, *black_player, max_moves, record_game ? &record : nullptr);
+                if (record_game) {
+                    record_game(record);
+                }
+                if (winner == WHITE) {
+                    ++batch.white_wins;
+                } else if (winner == BLACK) {
+                    ++batch.black_wins;
+                } else {
+                    ++batch.draws;
+                }
+                if (batch.games() == BATCH_SIZE) {
+                    add_batch();
+                }
+            }
+            add_batch();
+            --threads_running;
+        });
+    }
+
+    auto totals = [&]() {
+        GameCounts counts;
+        counts.white_wins = white_wins.load(memory_order_relaxed);
+        counts.black_wins = black_wins.load(memory_order_relaxed);
+        counts.draws = draws.load(memory_order_relaxed);
+        return counts;
+    };
+
+    // report how it's going while the threads play
+    uint64_t next_report = report_every;
+    while (threads_running > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        GameCounts counts = totals();
+        if (report && report_every != 0 && counts.games() >= next_report && counts.games() < num_games) {
+            report(counts);
+            while (next_report <= counts.games()) {
+                next_report += report_every;
+            }
+        }
+    }
+    for (thread &t : threads) {
+        t.join();
+    }
+
+    GameCounts counts = totals();
+    if (report) {
+        report(counts);
+    }
+    return counts;
+}
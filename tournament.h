@@ -0,0 +1,60 @@
+#ifndef _TOURNAMENT_H_
+#define _TOURNAMENT_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "chess_board.h"
+#include "chess_player.h"
+#include "game_record.h"
+
+using std::function;
+using std::unique_ptr;
+
+// Makes a player for team. Players that make random choices should make
+// them from seed, so that every player gets its own stream of random numbers.
+typedef function<unique_ptr<Player>(Team team, unsigned seed)> PlayerMaker;
+// Is given the record of every game a Tournament plays, from the thread that
+// played it (so it has to be safe to call from many threads at once).
+typedef function<void(const GameRecord &record)> GameRecorder;
+
+struct GameCounts {
+    uint64_t white_wins = 0;
+    uint64_t black_wins = 0;
+    uint64_t draws = 0;  // games that hit the move limit
+
+    uint64_t games() const {
+        return white_wins + black_wins + draws;
+    }
+};
+
+// Plays a game on a new board. Returns the winner, or NONE if nobody has
+// won after max_moves moves (of either team). A player that chooses a move
+// that isn't legal loses straight away (the move isn't played or recorded).
+// If record isn't null, the game is recorded in it.
+Team play_game(Player &white_player, Player &black_player, int max_moves, GameRecord *record = nullptr);
+
+// Plays lots of games at once. Each thread makes its own pair of players
+// (since players aren't safe to share between threads) and plays games
+// until they've all been played.
+class Tournament {
+    PlayerMaker make_white_player, make_black_player;
+    int num_threads;
+    unsigned seed;
+    int max_moves;
+    GameRecorder record_game;
+
+   public:
+    // Each thread's players get seeds made from seed and the thread's number.
+    // Games are only recorded if there's a record_game to give them to.
+    Tournament(PlayerMaker make_white_player, PlayerMaker make_black_player, int num_threads, unsigned seed, int max_moves = 1000,
+               GameRecorder record_game = nullptr);
+
+    // Plays num_games games and returns how they went. Every time about
+    // report_every more games have finished (and once at the end), report
+    // is called with the counts so far, always from the thread that called run.
+    GameCounts run(uint64_t num_games, uint64_t report_every, function<void(const GameCounts &)> report) const;
+};
+
+#endif  // _TOURNAMENT_H_
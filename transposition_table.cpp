@@ -0,0 +1,109 @@
+#include "transposition_table.h"
+
+#include <atomic>
+#include <cstdint>
+
+#include "chess_board.h"
+
+using std::memory_order_relaxed;
+
+// An entry's data is packed into 64 bits:
+//   bits  0-31  score
+//   bits 32-55  best move (the squares of a PackedMove, without its flags)
+//   bits 56-61  depth
+//   bits 62-63  bound (never 0, which is how empty slots are told apart)
+
+static uint64_t pack_entry(int score, int depth, TranspositionTable::Bound bound, PackedMove best_move) {
+    return static_cast<uint32_t>(score) |
+           static_cast<uint64_t>(best_move.raw() & PackedMove::SQUARES) << 32 |
+           static_cast<uint64_t>(depth) << 56 |
+           static_cast<uint64_t>(bound) << 62;
+}
+
+static TranspositionTable::Entry unpack_entry(uint64_t data) {
+    TranspositionTable::Entry entry;
+    entry.score = static_cast<int32_t>(static_cast<uint32_t>(data));
+    entry.best_move = PackedMove(static_cast<uint32_t>(data >> 32 & PackedMove::SQUARES));
+    entry.depth = data >> 56 & 63;
+    entry.bound = static_cast<TranspositionTable::Bound>(data >> 62);
+    return entry;
+}
+
+TranspositionTable::TranspositionTable(size_t megabytes) {
+    // the biggest power of 2 number of buckets that fits
+    num_buckets = 0;
+    if (megabytes > 0) {
+        num_buckets = 1;
+        while (num_buckets * 2 * sizeof(Bucket) <= megabytes * 1024 * 1024) {
+            num_buckets *= 2;
+        }
+    }
+    buckets.reset(new Bucket[num_buckets]);
+    bucket_mask = num_buckets - 1;
+    clear();
+}
+
+bool TranspositionTable::probe(uint64_t key, Entry &entry) const {
+    if (num_buckets == 0) {
+        return false;
+    }
+    for (const Slot &slot : buckets[key & bucket_mask].slots) {
+        uint64_t data = slot.data.load(memory_order_relaxed);
+        if ((slot.key_xor_data.load(memory_order_relaxed) ^ data) == key && data != 0) {
+            entry = unpack_entry(data);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TranspositionTable::store(uint64_t key, int score, int depth, Bound bound, PackedMove best_move) {
+    if (num_buckets == 0) {
+        return;
+    }
+    if (depth > MAX_DEPTH) {
+        depth = MAX_DEPTH;
+    }
+    Bucket &bucket = buckets[key & bucket_mask];
+
+    // Update the position if it's already here (unless what's here was
+    // searched deeper). Otherwise take an empty slot, or else the one that
+    // was searched the least deep.
+    Slot *replace = &bucket.slots[0];
+    int replace_depth = MAX_DEPTH + 1;
+    for (Slot &slot : bucket.slots) {
+        uint64_t data = slot.data.load(memory_order_relaxed);
+        int slot_depth = unpack_entry(data).depth;
+        if (data == 0) {
+            replace = &slot;
+            break;
+        }
+        if ((slot.key_xor_data.load(memory_order_relaxed) ^ data) == key) {
+            if (depth < slot_depth) {
+                return;
+            }
+            replace = &slot;
+            break;
+        }
+        if (slot_depth < replace_depth) {
+            replace = &slot;
+            replace_depth = slot_depth;
+        }
+    }
+    uint64_t data = pack_entry(score, depth, bound, best_move);
+    replace->key_xor_data.store(key ^ data, memory_order_relaxed);
+    replace->data.store(data, memory_order_relaxed);
+}
+
+void TranspositionTable::clear() {
+    for (size_t i = 0; i < num_buckets; ++i) {
+        for (Slot &slot : buckets[i].slots) {
+            slot.key_xor_data.store(0, memory_order_relaxed);
+            slot.data.store(0, memory_order_relaxed);
+        }
+    }
+}
+
+size_t TranspositionTable::capacity() const {
+    return num_buckets * SLOTS_PER_BUCKET;
+}
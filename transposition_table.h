@@ -0,0 +1,74 @@
+#ifndef _TRANSPOSITION_TABLE_H_
+#define _TRANSPOSITION_TABLE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "chess_board.h"
+
+using std::atomic;
+using std::unique_ptr;
+
+// Remembers what searching a position found, keyed on Board::hash(), so that
+// a search doesn't have to redo the work when it reaches the same position
+// through a different order of moves (or on a later move of the game).
+//
+// The table has a fixed size. Each 64-byte bucket (one cache line) holds 4
+// entries, and a position can only go in the bucket its key picks. When the
+// bucket is full, the entry that was searched the least deep is thrown out,
+// since it was the cheapest one to find.
+//
+// Any number of threads can probe and store at the same time without
+// locking. Each slot keeps its key XORed with its data, so an entry that
+// one thread reads while another is halfway through writing it doesn't
+// match any key, and is just missed.
+class TranspositionTable {
+   public:
+    // How the stored score relates to the real score of the position.
+    enum Bound : uint8_t {
+        EXACT = 1,  // it is the real score
+        LOWER = 2,  // the real score is at least this
+        UPPER = 3   // the real score is at most this
+    };
+
+    struct Entry {
+        int score;
+        int depth;  // how many moves deep the position was searched
+        Bound bound;
+        PackedMove best_move;  // without its flags
+    };
+
+    // Deepest search depth an entry can remember; deeper ones are stored as this.
+    static constexpr int MAX_DEPTH = 63;
+
+    // Uses (at most) megabytes MB of memory. A table of 0 MB never remembers anything.
+    explicit TranspositionTable(size_t megabytes);
+
+    // Returns true and fills in entry if key is in the table.
+    bool probe(uint64_t key, Entry &entry) const;
+    void store(uint64_t key, int score, int depth, Bound bound, PackedMove best_move);
+    // Forgets everything.
+    void clear();
+    // How many entries the table can hold.
+    size_t capacity() const;
+
+   private:
+    // An entry packed into 64 bits (see transposition_table.cpp). A data of
+    // 0 means the slot is empty.
+    struct Slot {
+        atomic<uint64_t> key_xor_data;
+        atomic<uint64_t> data;
+    };
+    static constexpr int SLOTS_PER_BUCKET = 4;
+    struct alignas(64) Bucket {
+        Slot slots[SLOTS_PER_BUCKET];
+    };
+
+    unique_ptr<Bucket[]> buckets;
+    size_t num_buckets;  // a power of 2 (or 0)
+    uint64_t bucket_mask;
+};
+
+#endif  // _TRANSPOSITION_TABLE_H_
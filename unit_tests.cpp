@@ -1,11 +1,30 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <cassert>
+#include <set>
 #include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
 #include <vector>
 
+#include "attack_tables.h"
+#include "background_writer.h"
+#include "bitboard.h"
 #include "chess_board.h"
 #include "chess_pieces.h"
 #include "chess_player.h"
+#include "game_record.h"
+#include "opening_book.h"
+#include "perft.h"
+#include "position_database.h"
+#include "position_notation.h"
+#include "tournament.h"
+#include "transposition_table.h"
 #include "utf8_codepoint.h"
 using namespace std;
 
@@ -133,12 +152,12 @@ ostream& operator<<(ostream& os, const vector<T> v) {
 }
 // make sure that all the moves returned follow the displacements set by 'directions'
 void test_get_moves(const ChessPiece& piece, const Board& board, const Cell& cur_cell, const vector<Cell>& directions) {
-    vector<Move> moves;
+    MoveList moves;
     piece.get_moves(board, cur_cell, moves);
     vector<Cell> destinations;  // faster search times
 
     // fill destinations
-    for (const Move& m : moves) {
+    for (Move m : moves) {
         destinations.push_back(m.to);
         assert(board[m.to].team != piece.team);
         assert(board.contains(m.to));
@@ -197,6 +216,1322 @@ void test_winner(Board& board) {
         temp << "Expected the winner to be " << actual_winner << " but got " << winner;
         assertm(actual_winner == winner, temp.str());
     }
+
+    // the black king gets blown up (and comes back when the move is taken back)
+    istringstream in(
+        "   abcd\n"
+        " 4 ..♚. 4\n"
+        " 3 ..☆. 3\n"
+        " 2 .... 2\n"
+        " 1 .♔.. 1\n"
+        "   abcd\n");
+    in >> board;
+    assertm(board.winner() == NONE, "expected nobody to have won before the explosion");
+    board.make_move(Move(Cell(2, 2), Cell(2, 2)));
+    assertm(board.winner() == WHITE, "expected white to win by blowing up the black king");
+    board.unmake_move();
+    assertm(board.winner() == NONE, "expected nobody to have won after taking back the explosion");
+}
+
+bool move_less_than(Move a, Move b) {
+    return make_pair(make_pair(a.from.x, a.from.y), make_pair(a.to.x, a.to.y)) <
+           make_pair(make_pair(b.from.x, b.from.y), make_pair(b.to.x, b.to.y));
+}
+
+// the moves you get by asking every piece on the board for its moves
+vector<Move> get_moves_of_each_piece(const Board& board) {
+    MoveList moves;
+    for (size_t y = 0; y < board.get_height(); ++y) {
+        for (size_t x = 0; x < board.get_width(); ++x) {
+            if (board[Cell(x, y)].team == board.get_current_teams_turn()) {
+                board[Cell(x, y)].get_moves(board, Cell(x, y), moves);
+            }
+        }
+    }
+    return vector<Move>(moves.begin(), moves.end());
+}
+
+// a board with every kind of piece on it (including the custom ones)
+const char* CUSTOM_PIECES_BOARD =
+    "   abcdefgh\n"
+    " 8 ♜.▼.♚..★ 8\n"
+    " 7 ♟♟.♟♟.♟♟ 7\n"
+    " 6 ..♝.☆... 6\n"
+    " 5 .▽..♟.▼. 5\n"
+    " 4 ..♙.♘... 4\n"
+    " 3 ▽....♕.. 3\n"
+    " 2 ♙☆♙.♙♙♙♙ 2\n"
+    " 1 ♖..♔..▽♖ 1\n"
+    "   abcdefgh\n";
+
+void read_custom_pieces_board(Board& board) {
+    istringstream in(CUSTOM_PIECES_BOARD);
+    in >> board;
+}
+
+// makes sure the bitboard move generator finds the same moves as the pieces do
+void test_bitboard_moves(Board& board, int num_turns) {
+    for (int turn = 0; turn < num_turns && board.winner() == NONE; ++turn) {
+        vector<Move> expected = get_moves_of_each_piece(board);
+        MoveList found;
+        get_bitboard_moves(board, found);
+        for (PackedMove move : found) {
+            ostringstream temp;
+            temp << "expected " << move << " to be flagged as a capture or explosion if (and only if) it is one on board\n"
+                 << board;
+            assertm(move.is_capture() == board[move.from()].is_opposite_team(board[move.to()]), temp.str());
+            assertm(move.is_explosion() == (!move.is_capture() && move.from() == move.to()), temp.str());
+        }
+        vector<Move> actual(found.begin(), found.end());
+        sort(expected.begin(), expected.end(), move_less_than);
+        sort(actual.begin(), actual.end(), move_less_than);
+
+        ostringstream temp;
+        temp << "expected the bitboard moves to be " << expected << " but got " << actual << " on board\n"
+             << board;
+        assertm(expected == actual, temp.str());
+
+        board.make_move(expected[rand() % expected.size()]);
+    }
+}
+
+void test_bitboard_moves() {
+    // both the single word and the wide bitboards
+    for (int width : {2, 3, 5, 8, 11, 26}) {
+        for (int height : {2, 4, 7, 8, 13, 99}) {
+            Board board(width, height);
+            test_bitboard_moves(board, 50);
+        }
+    }
+
+    // the custom pieces
+    Board board;
+    read_custom_pieces_board(board);
+    test_bitboard_moves(board, 100);
+}
+
+// makes sure get_piece_moves finds the same moves as each piece's own get_moves,
+// for both teams' pieces on every square
+void test_get_piece_moves() {
+    Board board;
+    read_custom_pieces_board(board);
+    for (int turn = 0; turn < 30 && board.winner() == NONE; ++turn) {
+        for (size_t y = 0; y < board.get_height(); ++y) {
+            for (size_t x = 0; x < board.get_width(); ++x) {
+                MoveList expected_list, actual_list;
+                board[Cell(x, y)].get_moves(board, Cell(x, y), expected_list);
+                get_piece_moves(board, Cell(x, y), actual_list);
+                vector<Move> expected(expected_list.begin(), expected_list.end());
+                vector<Move> actual(actual_list.begin(), actual_list.end());
+                ostringstream temp;
+                temp << "expected get_piece_moves to give " << expected << " but got " << actual << " on board\n"
+                     << board;
+                assertm(expected == actual, temp.str());
+            }
+        }
+        MoveList moves = board.get_moves();
+        board.make_move(moves[rand() % moves.size()]);
+    }
+}
+
+// makes sure a custom pawn that moves further than the frame around the
+// board is deep doesn't look off the end of it
+void test_long_pawn_moves() {
+    static const Pawn WHITE_LONG_PAWN(U'⇑', WHITE, 3), BLACK_LONG_PAWN(U'⇓', BLACK, -3);
+    Board board;
+    for (int x = 0; x < 8; ++x) {
+        for (int y = 0; y < 8; ++y) {
+            board.set_piece(Cell(x, y), EMPTY_SPACE);
+        }
+    }
+    board.set_piece(Cell(0, 6), WHITE_LONG_PAWN);
+    board.set_piece(Cell(7, 7), WHITE_LONG_PAWN);
+    board.set_piece(Cell(3, 2), WHITE_LONG_PAWN);
+    board.set_piece(Cell(2, 5), BLACK_KING);
+    board.set_piece(Cell(0, 1), BLACK_LONG_PAWN);
+    board.set_piece(Cell(4, 0), WHITE_KING);
+    MoveList moves;
+    WHITE_LONG_PAWN.get_moves(board, Cell(0, 6), moves);
+    WHITE_LONG_PAWN.get_moves(board, Cell(7, 7), moves);
+    BLACK_LONG_PAWN.get_moves(board, Cell(0, 1), moves);
+    assertm(moves.size() == 0, "expected a pawn whose move goes off the board to have no moves");
+    WHITE_LONG_PAWN.get_moves(board, Cell(3, 2), moves);
+    vector<Move> found(moves.begin(), moves.end());
+    vector<Move> expected = {Move(Cell(3, 2), Cell(3, 5)), Move(Cell(3, 2), Cell(2, 5))};
+    assertm(found == expected, "expected a long pawn to move and capture 3 squares ahead, but got " << found);
+    assertm(board.get_moves().size() == 2 + 5, "expected the board to give the long pawns' moves and the king's");
+}
+
+// a king that can also jump two squares to the right, which the board only
+// knows about because it's made as a CUSTOM piece
+class JumpingKing : public King {
+   public:
+    JumpingKing(UTF8CodePoint cp, Team team) : King(cp, team, CUSTOM) {}
+    void get_moves(const Board& board, Cell from, MoveList& moves) const override {
+        King::get_moves(board, from, moves);
+        Cell to(from.x + 2, from.y);
+        if (board.contains(to) && board[to].team == NONE) {
+            moves.emplace_back(from, to);
+        }
+    }
+};
+
+// makes sure the board uses the overrides of a subclass of a built-in piece
+// that passes CUSTOM to its constructor
+void test_piece_subclasses() {
+    static const JumpingKing WHITE_JUMPING_KING(U'⤳', WHITE);
+    Board board;
+    for (int x = 0; x < 8; ++x) {
+        for (int y = 0; y < 8; ++y) {
+            board.set_piece(Cell(x, y), EMPTY_SPACE);
+        }
+    }
+    board.set_piece(Cell(3, 3), WHITE_JUMPING_KING);
+    board.set_piece(Cell(7, 7), BLACK_KING);
+    MoveList virtual_moves, piece_moves;
+    WHITE_JUMPING_KING.get_moves(board, Cell(3, 3), virtual_moves);
+    get_piece_moves(board, Cell(3, 3), piece_moves);
+    assertm(virtual_moves.size() == 9, "expected the jumping king to have 9 moves, but it has " << virtual_moves.size());
+    assertm(piece_moves.size() == 9, "expected get_piece_moves to give the jumping king 9 moves, but it gave " << piece_moves.size());
+    assertm(board.get_moves().size() == 9, "expected the board to give the jumping king 9 moves");
+    board.make_move(Move(Cell(3, 3), Cell(5, 3)));
+    assertm(&board[Cell(5, 3)] == &WHITE_JUMPING_KING, "expected the jumping king to have jumped");
+}
+
+// a piece the board only knows through its virtual functions: it steps one
+// square forwards, backwards or sideways, or stays put and explodes, taking
+// the other team's pieces next to it with it
+class Grenadier : public ChessPiece {
+   public:
+    Grenadier(UTF8CodePoint cp, Team team) : ChessPiece(cp, team, CUSTOM) {}
+    void get_moves(const Board& board, Cell from, MoveList& moves) const override {
+        for (Cell step : {Cell(1, 0), Cell(-1, 0), Cell(0, 1), Cell(0, -1)}) {
+            Cell to(from.x + step.x, from.y + step.y);
+            if (board.contains(to) && board[to].team != team) {
+                moves.emplace_back(from, to);
+            }
+        }
+        moves.emplace_back(from, from);
+    }
+    void make_move(Board& board, Move move) const override {
+        if (move.from == move.to) {
+            board.make_explosion_move(move.from, 1);
+        } else {
+            board.make_classical_chess_move(move);
+        }
+    }
+};
+
+// the moves in moves that go from from, in order
+vector<Move> moves_from(const MoveList& moves, Cell from) {
+    vector<Move> found;
+    for (PackedMove move : moves) {
+        if (move.from() == from) {
+            found.push_back(move);
+        }
+    }
+    return found;
+}
+
+// makes sure a CUSTOM piece's moves come out of the board the same as out of
+// its own get_moves, with the flags filled in, and that its moves can be
+// taken back
+void test_custom_pieces() {
+    static const Grenadier WHITE_GRENADIER(U'⊕', WHITE);
+    Board board;
+    for (int x = 0; x < 8; ++x) {
+        for (int y = 0; y < 8; ++y) {
+            board.set_piece(Cell(x, y), EMPTY_SPACE);
+        }
+    }
+    board.set_piece(Cell(3, 3), WHITE_GRENADIER);
+    board.set_piece(Cell(0, 0), WHITE_GRENADIER);
+    board.set_piece(Cell(2, 3), WHITE_PAWN);
+    board.set_piece(Cell(3, 4), BLACK_ROOK);
+    board.set_piece(Cell(4, 3), BLACK_KNIGHT);
+    board.set_piece(Cell(7, 0), WHITE_KING);
+    board.set_piece(Cell(7, 7), BLACK_KING);
+
+    MoveList board_moves = board.get_moves(), board_captures = board.get_captures();
+    for (Cell from : {Cell(3, 3), Cell(0, 0)}) {
+        MoveList virtual_list, piece_list, capture_list;
+        WHITE_GRENADIER.get_moves(board, from, virtual_list);
+        get_piece_moves(board, from, piece_list);
+        get_piece_captures(board, from, capture_list);
+        vector<Move> virtual_moves(virtual_list.begin(), virtual_list.end());
+        vector<Move> piece_moves(piece_list.begin(), piece_list.end());
+        assertm(piece_moves == virtual_moves, "expected get_piece_moves to give " << virtual_moves << " but got " << piece_moves);
+        vector<Move> found = moves_from(board_moves, from);
+        assertm(found == virtual_moves, "expected the board to give " << virtual_moves << " but got " << found);
+
+        vector<Move> expected_captures;
+        for (PackedMove move : piece_list) {
+            bool capture = board[move.to()].team == BLACK;
+            bool explosion = move.to() == from;
+            assertm(move.is_capture() == capture, "expected " << move << " to be marked a capture only if it is one");
+            assertm(move.is_explosion() == explosion, "expected " << move << " to be marked an explosion only if it is one");
+            if (capture || explosion) {
+                expected_captures.push_back(move);
+            }
+        }
+        vector<Move> captures(capture_list.begin(), capture_list.end());
+        assertm(captures == expected_captures, "expected get_piece_captures to give " << expected_captures << " but got " << captures);
+        found = moves_from(board_captures, from);
+        assertm(found == expected_captures, "expected the board's captures to be " << expected_captures << " but got " << found);
+    }
+
+    Board start = board;
+    uint64_t hash = board.hash();
+    int white_material = board.material(WHITE), black_material = board.material(BLACK);
+    for (PackedMove move : board_moves) {
+        board.make_move(move);
+        if (move == PackedMove(Cell(3, 3), Cell(3, 3))) {
+            assertm(board.material(BLACK) == black_material - board.piece_value(BLACK_ROOK) - board.piece_value(BLACK_KNIGHT),
+                    "expected the grenadier's explosion to take the rook and the knight");
+        }
+        board.unmake_move();
+        assertm(board == start, "expected unmaking " << move << " to give back the board");
+        assertm(board.hash() == hash, "expected unmaking " << move << " to give back the hash");
+        assertm(board.material(WHITE) == white_material && board.material(BLACK) == black_material,
+                "expected unmaking " << move << " to give back the material");
+    }
+}
+
+// makes sure a piece gives its code back when it's destroyed, so that it
+// can't be found any more and many more pieces than there are codes can be
+// made one after another
+void test_piece_codes() {
+    uint8_t first_code;
+    {
+        Rook rook(U'⛫', WHITE);
+        first_code = rook.code;
+        assertm(ChessPiece::with_code_point(U'⛫') == &rook, "expected a new piece to be found by its code point");
+    }
+    assertm(ChessPiece::with_code_point(U'⛫') == nullptr, "expected a destroyed piece not to be found");
+    assertm(ChessPiece::piece_by_code[first_code] == nullptr && ChessPiece::type_by_code[first_code] == EMPTY,
+            "expected a destroyed piece's code to be cleared");
+    for (int i = 0; i < 1000; ++i) {
+        Rook rook(U'⛫', WHITE);
+        assertm(rook.code == first_code, "expected a destroyed piece's code to be used again");
+    }
+}
+
+// makes sure packed moves keep every square of the biggest board, that the
+// flags don't change which move it is, and that move lists can outgrow the
+// room they start with
+void test_packed_moves() {
+    PackedMove move(Cell(25, 98), Cell(0, 97), PackedMove::CAPTURE);
+    assertm(move.from() == Cell(25, 98) && move.to() == Cell(0, 97), "expected a packed move to keep its squares");
+    assertm(move.is_capture() && !move.is_explosion(), "expected a packed move to keep its flags");
+    assertm(move == PackedMove(Move(Cell(25, 98), Cell(0, 97))), "expected the flags not to matter when comparing moves");
+    assertm(PackedMove(move.raw()).raw() == move.raw(), "expected a packed move to come back the same from its raw bits");
+
+    MoveList moves;
+    for (int i = 0; i < 1000; ++i) {
+        moves.emplace_back(Cell(i % 26, i / 26), Cell(0, 0));
+    }
+    MoveList copy = moves;
+    moves.clear();
+    assertm(moves.empty() && copy.size() == 1000, "expected a move list to hold more moves than fit on the stack");
+    for (int i = 0; i < 1000; ++i) {
+        assertm(copy[i].from() == Cell(i % 26, i / 26), "expected a grown move list to keep its moves in order");
+    }
+}
+
+// makes sure a position's legal move set has every move it should (and
+// nothing else), on boards with moves both on the stack and on the heap
+void test_legal_moves() {
+    for (int width : {8, 26}) {
+        Board board(width, width == 8 ? 8 : 99);
+        for (int turn = 0; turn < 20 && board.winner() == NONE; ++turn) {
+            LegalMoves legal = board.get_legal_moves();
+            const MoveList& moves = legal.get_moves();
+            for (Move move : moves) {
+                assertm(legal.is_legal(move), "expected every generated move to be legal");
+            }
+            for (int i = 0; i < 1000; ++i) {
+                Move move(Cell(rand() % 30 - 2, rand() % 30 - 2), Cell(rand() % 30 - 2, rand() % 30 - 2));
+                bool listed = find(moves.begin(), moves.end(), move) != moves.end();
+                ostringstream temp;
+                temp << "expected is_legal(" << move << ") to be " << listed << " on board\n"
+                     << board;
+                assertm(legal.is_legal(move) == listed, temp.str());
+            }
+            board.make_move(moves[rand() % moves.size()]);
+        }
+    }
+
+    // a move that doesn't fit in a PackedMove isn't mistaken for one that does
+    Board board;
+    LegalMoves legal = board.get_legal_moves();
+    assertm(legal.is_legal(Move(Cell(0, 1), Cell(0, 2))), "expected a pawn push to be legal");
+    assertm(!legal.is_legal(Move(Cell(32, 1), Cell(0, 2))), "expected a move from off the board not to be legal");
+
+    // more moves than fit on the stack
+    MoveList many;
+    for (int i = 0; i < 1000; ++i) {
+        many.emplace_back(Cell(i % 26, i / 26), Cell(0, 0));
+    }
+    LegalMoves many_legal(many);
+    for (int i = 0; i < 1000; ++i) {
+        assertm(many_legal.is_legal(Move(Cell(i % 26, i / 26), Cell(0, 0))), "expected every move in a big list to be legal");
+    }
+    assertm(!many_legal.is_legal(Move(Cell(0, 50), Cell(0, 0))), "expected a move that isn't in a big list not to be legal");
+}
+
+// what board.material should be, counting the pieces one at a time
+int count_material(const Board& board, Team team) {
+    int total = 0;
+    for (size_t y = 0; y < board.get_height(); ++y) {
+        for (size_t x = 0; x < board.get_width(); ++x) {
+            if (board[Cell(x, y)].team == team) {
+                total += board.piece_value(board[Cell(x, y)]);
+            }
+        }
+    }
+    return total;
+}
+
+// makes sure the material is kept up to date through moves, explosions and
+// unmaking them, on every size of board, and follows the piece values it's given
+void test_material() {
+    Board start;
+    assertm(start.material(WHITE) == 139 && start.material(BLACK) == 139, "expected both teams to start with 139 worth of pieces");
+
+    Board boards[] = {Board(), Board(3, 4), Board(26, 99), Board()};
+    read_custom_pieces_board(boards[3]);
+    for (Board& board : boards) {
+        int turn = 0;
+        for (; turn < 60 && board.winner() == NONE; ++turn) {
+            MoveList moves = board.get_moves();
+            board.make_move(moves[rand() % moves.size()]);
+            for (Team team : {WHITE, BLACK}) {
+                ostringstream temp;
+                temp << "expected " << team_name(team) << " to have " << count_material(board, team) << " worth of pieces but the board says "
+                     << board.material(team) << " on board\n"
+                     << board;
+                assertm(board.material(team) == count_material(board, team), temp.str());
+            }
+        }
+        for (; turn > 0; --turn) {
+            board.unmake_move();
+        }
+        assertm(board.material(WHITE) == count_material(board, WHITE) && board.material(BLACK) == count_material(board, BLACK),
+                "expected unmaking every move to give back the material");
+    }
+
+    PieceValues values;
+    values.cannon = 7;
+    values.bomb_tower = 2;
+    values.custom = 4;
+    Board custom;
+    read_custom_pieces_board(custom);
+    custom.set_piece_values(values);
+    assertm(custom.piece_value(WHITE_CANNON) == 7 && custom.piece_value(BLACK_BOMBTOWER) == 2, "expected the new piece values to be used");
+    assertm(custom.material(WHITE) == count_material(custom, WHITE) && custom.material(BLACK) == count_material(custom, BLACK),
+            "expected changing the piece values to count the material again");
+}
+
+// whether move takes something, worked out from the board rather than the
+// capture generator
+bool takes_something(const Board& board, PackedMove move) {
+    const ChessPiece& piece = board[move.from()];
+    if (piece.is_opposite_team(board[move.to()])) {
+        return true;
+    }
+    if (move.from() != move.to()) {
+        return false;
+    }
+    if (piece.type != BOMB_TOWER) {
+        return true;  // a custom piece's explosion might take anything
+    }
+    for (int dy = -2; dy <= 2; ++dy) {
+        for (int dx = -2; dx <= 2; ++dx) {
+            Cell target(move.from().x + dx, move.from().y + dy);
+            if (board.contains(target) && piece.is_opposite_team(board[target])) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// makes sure the captures are exactly the moves that take something, both
+// for the whole board and for each piece, and that capturing a king is spotted
+void test_get_captures() {
+    Board boards[] = {Board(), Board(5, 7), Board(11, 13), Board(26, 99), Board()};
+    read_custom_pieces_board(boards[4]);
+    for (Board& board : boards) {
+        for (int turn = 0; turn < 80 && board.winner() == NONE; ++turn) {
+            MoveList moves = board.get_moves();
+            vector<Move> expected;
+            bool can_win = false;
+            for (PackedMove move : moves) {
+                if (takes_something(board, move)) {
+                    expected.push_back(move);
+                }
+                Board after = board;
+                after.make_move(move);
+                can_win = can_win || after.winner() == board.get_current_teams_turn();
+            }
+            MoveList captures = board.get_captures();
+            vector<Move> actual(captures.begin(), captures.end());
+            sort(expected.begin(), expected.end(), move_less_than);
+            sort(actual.begin(), actual.end(), move_less_than);
+            ostringstream temp;
+            temp << "expected the captures to be " << expected << " but got " << actual << " on board\n"
+                 << board;
+            assertm(expected == actual, temp.str());
+            temp.str("");
+            temp << "expected can_capture_king to be " << can_win << " on board\n"
+                 << board;
+            assertm(board.can_capture_king() == can_win, temp.str());
+
+            for (size_t y = 0; y < board.get_height(); ++y) {
+                for (size_t x = 0; x < board.get_width(); ++x) {
+                    MoveList expected_list, actual_list;
+                    board[Cell(x, y)].get_captures(board, Cell(x, y), expected_list);
+                    get_piece_captures(board, Cell(x, y), actual_list);
+                    assertm(vector<Move>(expected_list.begin(), expected_list.end()) == vector<Move>(actual_list.begin(), actual_list.end()),
+                            "expected get_piece_captures to give the same captures as the piece's own get_captures");
+                }
+            }
+
+            // play a capture when there is one, so the boards get to the kings
+            board.make_move(captures.empty() ? moves[rand() % moves.size()] : captures[rand() % captures.size()]);
+        }
+    }
+}
+
+// makes sure the leaper tables have every jump that stays on the board (and
+// nothing else), that the rays go all the way to the edge, and that boards of
+// the same size share the tables
+void test_attack_tables() {
+    vector<pair<Leaper, int>> reaches = {{KING_LEAPS, 1}, {KNIGHT_LEAPS, 2}, {BOMB_TOWER_LEAPS, 2}};
+    for (int width : {2, 5, 8, 26}) {
+        for (int height : {2, 7, 8, 99}) {
+            Board board(width, height), other_board(width, height);
+            assertm(&board.get_attack_tables() == &other_board.get_attack_tables(), "expected boards of the same size to share their tables");
+            const AttackTables &tables = board.get_attack_tables();
+            for (pair<Leaper, int> reach : reaches) {
+                for (int y = 0; y < height; ++y) {
+                    for (int x = 0; x < width; ++x) {
+                        set<pair<int, int>> expected, actual;
+                        uint64_t expected_mask = 0;
+                        for (int dx = -reach.second; dx <= reach.second; ++dx) {
+                            for (int dy = -reach.second; dy <= reach.second; ++dy) {
+                                bool knight_jump = dx * dx + dy * dy == 5;
+                                bool is_jump = reach.first == KNIGHT_LEAPS ? knight_jump : reach.first == BOMB_TOWER_LEAPS || dx != 0 || dy != 0;
+                                if (is_jump && board.contains(Cell(x + dx, y + dy))) {
+                                    expected.insert(make_pair(x + dx, y + dy));
+                                    // masks are only made for boards that fit in one word
+                                    if (width * height <= 64 && (dx != 0 || dy != 0)) {
+                                        expected_mask |= uint64_t(1) << ((y + dy) * width + x + dx);
+                                    }
+                                }
+                            }
+                        }
+                        for (LeaperTarget target : tables.leaper_targets(reach.first, Cell(x, y))) {
+                            actual.insert(make_pair(x + target.dx, y + target.dy));
+                            assertm(target.index_offset == board.index_offset(Cell(target.dx, target.dy)), "expected the target's index offset to match the board's");
+                        }
+                        assertm(expected == actual, "expected the leaper targets from " << Cell(x, y) << " on a " << width << 'x' << height << " board to be every jump on the board");
+                        if (width * height <= 64) {
+                            assertm(tables.leaper_mask(reach.first, y * width + x) == expected_mask, "expected the leaper mask from " << Cell(x, y) << " to match its targets");
+                        }
+                    }
+                }
+            }
+
+            // the rays, which only small boards have
+            if (width * height > 64) {
+                continue;
+            }
+            const Cell steps[NUM_DIRECTIONS] = {{0, 1}, {1, 0}, {-1, 1}, {1, 1}, {0, -1}, {-1, 0}, {1, -1}, {-1, -1}};
+            for (int direction = 0; direction < NUM_DIRECTIONS; ++direction) {
+                for (int square = 0; square < width * height; ++square) {
+                    uint64_t expected = 0;
+                    for (Cell to(square % width + steps[direction].x, square / width + steps[direction].y); board.contains(to);
+                         to = Cell(to.x + steps[direction].x, to.y + steps[direction].y)) {
+                        expected |= uint64_t(1) << (to.y * width + to.x);
+                    }
+                    assertm(tables.ray_mask(static_cast<Direction>(direction), square) == expected, "expected ray " << direction << " from square " << square << " to reach the edge of the board");
+                }
+            }
+        }
+    }
+
+    // sizes there can't be a board of are refused rather than looked up
+    for (Cell size : {Cell(27, 8), Cell(8, 100), Cell(1, 8), Cell(8, 1)}) {
+        bool threw = false;
+        try {
+            AttackTables::get(size.x, size.y);
+        } catch (invalid_argument e) {
+            threw = true;
+        }
+        assertm(threw, "expected there to be no attack tables for a " << size.x << " by " << size.y << " board");
+    }
+}
+
+// everything that make_move + unmake_move should leave the way it was
+string describe(const Board& board) {
+    MoveList found = board.get_moves();
+    vector<Move> moves(found.begin(), found.end());
+    sort(moves.begin(), moves.end(), move_less_than);
+    ostringstream temp;
+    temp << board << team_name(board.get_current_teams_turn()) << ' ' << board.winner() << ' ' << board.hash() << ' ' << moves;
+    return temp.str();
+}
+
+// makes sure that unmake_move undoes every possible move (including explosions)
+void test_unmake_move(Board& board, int num_turns) {
+    string start = describe(board);
+    int num_made = 0;
+    for (; num_made < num_turns && board.winner() == NONE; ++num_made) {
+        string before = describe(board);
+        MoveList moves = board.get_moves();
+        for (Move move : moves) {
+            board.make_move(move);
+            board.unmake_move();
+
+            ostringstream temp;
+            temp << "expected unmaking " << move << " to give back\n"
+                 << before << "\nbut got\n"
+                 << describe(board);
+            assertm(describe(board) == before, temp.str());
+        }
+        board.make_move(moves[rand() % moves.size()]);
+    }
+
+    // and then take back the whole game
+    for (; num_made > 0; --num_made) {
+        board.unmake_move();
+    }
+    assertm(describe(board) == start, "expected unmaking every move to give back the starting board");
+
+    bool threw_error = false;
+    try {
+        board.unmake_move();
+    } catch (logic_error& e) {
+        threw_error = true;
+    }
+    assertm(threw_error, "expected board.unmake_move to throw an error when there are no moves to take back");
+}
+
+void test_unmake_move() {
+    for (int width : {3, 8, 11}) {
+        for (int height : {4, 8, 13}) {
+            Board board(width, height);
+            test_unmake_move(board, 40);
+        }
+    }
+
+    Board board;
+    read_custom_pieces_board(board);
+    test_unmake_move(board, 40);
+
+    // copies start with no moves to take back, and don't change the original's
+    board.make_move(board.get_moves()[0]);
+    Board copy = board, assigned;
+    assigned = board;
+    for (Board* other : {&copy, &assigned}) {
+        assertm(*other == board && other->hash() == board.hash(), "expected a copy to be the same board");
+        bool threw = false;
+        try {
+            other->unmake_move();
+        } catch (logic_error& e) {
+            threw = true;
+        }
+        assertm(threw, "expected a copy of a board to have no moves to take back");
+    }
+    board.unmake_move();
+}
+
+// the same position always gets the same hash, however it was reached
+void test_hash() {
+    Board start, knights_first, other_knights_first;
+    for (Move move : {Move(Cell(1, 0), Cell(2, 2)), Move(Cell(1, 7), Cell(2, 5)), Move(Cell(6, 0), Cell(5, 2)), Move(Cell(6, 7), Cell(5, 5))}) {
+        knights_first.make_move(move);
+    }
+    for (Move move : {Move(Cell(6, 0), Cell(5, 2)), Move(Cell(6, 7), Cell(5, 5)), Move(Cell(1, 0), Cell(2, 2)), Move(Cell(1, 7), Cell(2, 5))}) {
+        other_knights_first.make_move(move);
+    }
+    assertm(knights_first == other_knights_first && knights_first.hash() == other_knights_first.hash(),
+            "expected the same position reached in a different order to be equal and have the same hash");
+    assertm(knights_first != start && knights_first.hash() != start.hash(), "expected different positions to have different hashes");
+
+    unordered_set<Board> seen = {start, knights_first, other_knights_first};
+    assertm(seen.size() == 2, "expected an unordered_set of boards to hold each position once");
+
+    // whose turn it is and the size of the board count too
+    Board black_to_move;
+    black_to_move.make_move(Move(Cell(1, 0), Cell(2, 2)));
+    black_to_move.make_move(Move(Cell(1, 7), Cell(2, 5)));
+    black_to_move.make_move(Move(Cell(2, 2), Cell(1, 0)));
+    assertm(black_to_move.hash() != start.hash(), "expected the hash to depend on whose turn it is");
+    assertm(Board(8, 9).hash() != Board(8, 10).hash(), "expected the hash to depend on the size of the board");
+
+    // the hash kept up to date move by move matches the one of the same
+    // board read in from scratch
+    Board board(11, 13);
+    for (int turn = 0; turn < 60 && board.winner() == NONE; ++turn) {
+        if (board.get_current_teams_turn() == WHITE) {
+            stringstream text;
+            text << board;
+            Board read;
+            text >> read;
+            assertm(read == board && read.hash() == board.hash(), "expected reading in a board to give the same hash");
+        }
+        MoveList moves = board.get_moves();
+        board.make_move(moves[rand() % moves.size()]);
+    }
+}
+
+void test_transposition_table() {
+    TranspositionTable table(1);
+    TranspositionTable::Entry entry;
+    assertm(!table.probe(12345, entry), "expected an empty table to have nothing in it");
+
+    // everything that goes in comes back out
+    Move move(Cell(25, 98), Cell(0, 97));
+    table.store(12345, -1000000, 7, TranspositionTable::UPPER, move);
+    assertm(table.probe(12345, entry) && entry.score == -1000000 && entry.depth == 7 && entry.bound == TranspositionTable::UPPER && entry.best_move == move,
+            "expected to get back the entry that was stored");
+
+    // a shallower search of the same position doesn't replace a deeper one
+    table.store(12345, 5, 3, TranspositionTable::EXACT, move);
+    assertm(table.probe(12345, entry) && entry.depth == 7, "expected the deeper entry to be kept");
+    table.store(12345, 5, 9, TranspositionTable::EXACT, move);
+    assertm(table.probe(12345, entry) && entry.depth == 9 && entry.score == 5, "expected the deeper entry to replace the old one");
+
+    // these keys all go in the same bucket; once it's full, the shallowest entry makes room
+    const uint64_t same_bucket = uint64_t(1) << 40;
+    for (int i = 1; i <= 4; ++i) {
+        table.store(i * same_bucket, i, 10 - i, TranspositionTable::EXACT, move);
+    }
+    table.store(5 * same_bucket, 5, 20, TranspositionTable::EXACT, move);
+    assertm(!table.probe(4 * same_bucket, entry), "expected the shallowest entry to be replaced");
+    assertm(table.probe(1 * same_bucket, entry) && table.probe(5 * same_bucket, entry), "expected the deeper entries to be kept");
+
+    table.clear();
+    assertm(!table.probe(5 * same_bucket, entry), "expected clear to empty the table");
+
+    TranspositionTable no_table(0);
+    no_table.store(12345, 1, 1, TranspositionTable::EXACT, move);
+    assertm(no_table.capacity() == 0 && !no_table.probe(12345, entry), "expected a 0MB table to never remember anything");
+}
+
+// makes sure the AI sees the obvious things, at every depth and with or without a transposition table
+void test_ai_player() {
+    for (int depth = 1; depth <= 5; ++depth) {
+        for (size_t table_megabytes : {0, 1}) {
+            AIPlayer ai(WHITE, table_megabytes, depth);
+            Board board;
+
+            // take the king when it can
+            istringstream take_king(
+                "   abcdefgh\n"
+                " 8 .......♚ 8\n"
+                " 7 ♟♟...... 7\n"
+                " 6 ........ 6\n"
+                " 5 ........ 5\n"
+                " 4 ........ 4\n"
+                " 3 ........ 3\n"
+                " 2 ♙♙...... 2\n"
+                " 1 ♔......♕ 1\n"
+                "   abcdefgh\n");
+            take_king >> board;
+            Move move = ai.get_move(board, board.get_moves());
+            assertm(move == Move(Cell(7, 0), Cell(7, 7)), "expected the AI to take the king");
+
+            // get its king out of the way of the rook
+            if (depth >= 2) {
+                istringstream save_king(
+                    "   abcdefgh\n"
+                    " 8 ♜....... 8\n"
+                    " 7 ........ 7\n"
+                    " 6 ........ 6\n"
+                    " 5 .......♚ 5\n"
+                    " 4 ........ 4\n"
+                    " 3 ........ 3\n"
+                    " 2 ........ 2\n"
+                    " 1 ♔....... 1\n"
+                    "   abcdefgh\n");
+                board = Board();
+                save_king >> board;
+                board.make_move(ai.get_move(board, board.get_moves()));
+                for (Move reply : board.get_moves()) {
+                    assertm(board[reply.to] != WHITE_KING, "expected the AI to move its king away from the rook");
+                }
+            }
+        }
+    }
+}
+
+// makes sure the AI keeps to its time and position budgets
+void test_ai_player_budget() {
+    Board board;
+
+    // it stops (nearly) on time, with a move from a search it finished
+    AIPlayer timed(WHITE, 1, 50, 20);
+    auto start = chrono::steady_clock::now();
+    Move move = timed.get_move(board, board.get_moves());
+    auto took = chrono::steady_clock::now() - start;
+    MoveList moves = board.get_moves();
+    assertm(find(moves.begin(), moves.end(), move) != moves.end(), "expected the AI to pick a valid move");
+    assertm(timed.last_search_info().depth >= 1 && timed.last_search_info().depth < 50, "expected the AI to finish some searches but not all of them");
+    assertm(took < chrono::seconds(1), "expected the AI to stop when it's out of time");
+
+    // a position budget is kept exactly, and always gives the same move
+    AIPlayer counted(WHITE, 1, 50, 0, 20000), counted_again(WHITE, 1, 50, 0, 20000);
+    move = counted.get_move(board, board.get_moves());
+    assertm(counted.last_search_info().nodes == 20000, "expected the AI to search exactly as many positions as it's allowed");
+    Move move_again = counted_again.get_move(board, board.get_moves());
+    assertm(move == move_again && counted.last_search_info().depth == counted_again.last_search_info().depth,
+            "expected the same position budget to give the same move");
+
+    // without a budget, it goes all the way
+    AIPlayer unlimited(WHITE, 1, 3);
+    unlimited.get_move(board, board.get_moves());
+    assertm(unlimited.last_search_info().depth == 3, "expected the AI to search as deep as it was told to");
+
+    // more threads still make a valid move on time
+    AIPlayer one_thread(WHITE, 1, 50, 100), four_threads(WHITE, 1, 50, 100, 0, 4);
+    one_thread.get_move(board, board.get_moves());
+    start = chrono::steady_clock::now();
+    move = four_threads.get_move(board, board.get_moves());
+    took = chrono::steady_clock::now() - start;
+    assertm(find(moves.begin(), moves.end(), move) != moves.end(), "expected the AI to pick a valid move with 4 threads");
+    assertm(took < chrono::seconds(1), "expected the AI to stop all its threads when it's out of time");
+    assertm(four_threads.last_search_info().depth >= 1, "expected the main thread to finish a search");
+}
+
+void test_tournament() {
+    RandomPlayer white_player(WHITE, 1), black_player(BLACK, 2);
+    assertm(play_game(white_player, black_player, 0) == NONE, "expected a game with no moves to be a draw");
+
+    // a player whose moves aren't legal loses, without them being played
+    struct IllegalPlayer : Player {
+        IllegalPlayer(Team team) : Player(team) {}
+        Move get_move(const Board&, const MoveList&) const override {
+            return Move(Cell(0, 0), Cell(7, 7));
+        }
+        const char* kind() const override {
+            return "IllegalPlayer";
+        }
+    };
+    IllegalPlayer cheater(BLACK);
+    GameRecord record;
+    assertm(play_game(white_player, cheater, 100, &record) == WHITE && record.winner == WHITE && record.moves.size() == 1,
+            "expected a player that makes a move that isn't legal to lose");
+
+    Tournament tournament(
+        [](Team team, unsigned seed) -> unique_ptr<Player> { return unique_ptr<Player>(new RandomPlayer(team, seed)); },
+        [](Team team, unsigned seed) -> unique_ptr<Player> { return unique_ptr<Player>(new CapturePlayer(team, seed)); },
+        3, 12345, 200);
+    GameCounts last_report;
+    int num_reports = 0;
+    GameCounts counts = tournament.run(100, 10, [&](const GameCounts &report) {
+        assertm(report.games() >= last_report.games(), "expected the reports to only count up");
+        last_report = report;
+        ++num_reports;
+    });
+    assertm(counts.games() == 100, "expected the tournament to play every game exactly once");
+    assertm(last_report.games() == 100 && num_reports >= 1, "expected the last report to have every game in it");
+
+    atomic<int> num_records(0);
+    Tournament recorded(
+        [](Team team, unsigned seed) -> unique_ptr<Player> { return unique_ptr<Player>(new RandomPlayer(team, seed)); },
+        [](Team team, unsigned seed) -> unique_ptr<Player> { return unique_ptr<Player>(new RandomPlayer(team, seed)); },
+        3, 12345, 200, [&](const GameRecord &record) {
+            if (record.white_player == "RandomPlayer" && record.moves.size() <= 200) {
+                ++num_records;
+            }
+        });
+    recorded.run(30, 0, nullptr);
+    assertm(num_records == 30, "expected the tournament to record every game");
+}
+
+// makes sure game records come back exactly as they were written (on small
+// and big boards), stay small, and that broken ones are caught
+void test_game_records() {
+    vector<GameRecord> records(4);
+    RandomPlayer white_player(WHITE, 3), black_player(BLACK, 4);
+    play_game(white_player, black_player, 100, &records[0]);
+
+    // a big board with the custom pieces on it, black to move
+    records[1].start = Board(26, 99);
+    records[1].start.set_piece(Cell(25, 50), WHITE_CANNON);
+    records[1].start.set_piece(Cell(3, 60), BLACK_BOMBTOWER);
+    records[1].start.set_current_teams_turn(BLACK);
+    records[1].white_player = "somebody";
+    Board board = records[1].start;
+    for (int turn = 0; turn < 50; ++turn) {
+        MoveList moves = board.get_moves();
+        records[1].moves.push_back(moves[rand() % moves.size()]);
+        board.make_move(records[1].moves.back());
+    }
+    records[1].winner = board.winner();
+
+    // a game that hasn't started
+    read_custom_pieces_board(records[2].start);
+
+    // a piece that's only known through its virtual functions
+    static const Grenadier BLACK_GRENADIER(U'⊗', BLACK);
+    records[3].start.set_piece(Cell(4, 5), BLACK_GRENADIER);
+    records[3].moves = {Move(Cell(4, 1), Cell(4, 2)), Move(Cell(4, 5), Cell(4, 4))};
+
+    stringstream file;
+    write_game_record_header(file);
+    for (const GameRecord& record : records) {
+        write_game_record(file, record);
+    }
+    assertm(file.str().size() < 5 + 400 + 2 * 26 * 99 + 250 + 9 + 150, "expected game records to be small");
+
+    read_game_record_header(file);
+    GameRecord read;
+    for (const GameRecord& record : records) {
+        bool found = read_game_record(file, read);
+        assertm(found, "expected to read every record back");
+        assertm(read.start == record.start && read.start.get_current_teams_turn() == record.start.get_current_teams_turn(),
+                "expected a record's starting board to come back the same");
+        assertm(read.white_player == record.white_player && read.black_player == record.black_player, "expected a record's players to come back the same");
+        assertm(read.moves == record.moves && read.winner == record.winner, "expected a record's moves and winner to come back the same");
+        ostringstream text;
+        write_game_text(text, read, LOG_BOARDS);
+        assertm(text.str().find(" vs ") != string::npos, "expected a record to be written as text");
+    }
+    bool found_more = read_game_record(file, read);
+    assertm(!found_more, "expected there to be no more records");
+
+    // broken records
+    bool threw = false;
+    try {
+        stringstream not_records("SCGX\1");
+        read_game_record_header(not_records);
+    } catch (invalid_argument e) {
+        threw = true;
+    }
+    assertm(threw, "expected reading something that isn't a game record file to throw");
+    string cut_short = file.str().substr(0, file.str().size() - 3);
+    threw = false;
+    try {
+        stringstream in(cut_short);
+        read_game_record_header(in);
+        while (read_game_record(in, read)) {
+        }
+    } catch (invalid_argument e) {
+        threw = true;
+    }
+    assertm(threw, "expected reading a record that's cut short to throw");
+    records[0].moves[5] = Move(Cell(0, 0), Cell(7, 7));
+    threw = false;
+    try {
+        ostringstream text;
+        write_game_text(text, records[0], LOG_MOVES);
+    } catch (invalid_argument e) {
+        threw = true;
+    }
+    assertm(threw, "expected replaying a record with a move that isn't legal to throw");
+}
+
+// makes sure boards are written out exactly the way they always have been
+void test_write_board() {
+    Board board;
+    read_custom_pieces_board(board);
+    ostringstream out;
+    out << board;
+    assertm(out.str() == CUSTOM_PIECES_BOARD, "expected a board to be written the same as before, but got\n"
+                                                  << out.str());
+
+    // ranks with 2 digits aren't padded, and the text is added to the end
+    string text = "before\n";
+    write_board(Board(2, 10), text);
+    assertm(text ==
+                "before\n"
+                "   ab\n"
+                "10 ♛♚ 10\n"
+                " 9 ♟♟ 9\n"
+                " 8 .. 8\n"
+                " 7 .. 7\n"
+                " 6 .. 6\n"
+                " 5 .. 5\n"
+                " 4 .. 4\n"
+                " 3 .. 3\n"
+                " 2 ♙♙ 2\n"
+                " 1 ♕♔ 1\n"
+                "   ab\n",
+            "expected a tall board to be written the same as before, but got\n"
+                << text);
+
+    ostringstream piece;
+    piece << WHITE_KING << BLACK_BOMBTOWER << EMPTY_SPACE;
+    assertm(piece.str() == "♔★.", "expected pieces to be written as their code points");
+}
+
+// makes sure reading a board that's too wide or too tall (or that isn't
+// there at all) fails and leaves the board alone
+void test_read_board_sizes() {
+    string wide = "   " + string(28, 'a') + "\n 2 " + string(28, '.') + " 2\n 1 " + string(28, '.') + " 1\n   " + string(28, 'a') + "\n";
+    string tall = "   ab\n";
+    for (int rank = 100; rank >= 1; --rank) {
+        tall += " " + to_string(rank) + " .. " + to_string(rank) + "\n";
+    }
+    tall += "   ab\n";
+    for (const string& text : {wide, tall, string("   a\n 1 . 1\n   a\n"), string()}) {
+        Board board;
+        istringstream in(text);
+        in >> board;
+        assertm(in.fail(), "expected reading a board that's the wrong size to fail");
+        assertm(board == Board(), "expected reading a board that's the wrong size to leave the board alone");
+    }
+}
+
+// makes sure positions come back the same after being written on one line
+void test_position_notation() {
+    Board board;
+    assertm(write_position(board) == "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w", "expected the starting position to be written like FEN");
+
+    // a piece without a letter is written as itself
+    static const Rook WHITE_SMILEY(U'😀', WHITE);
+    vector<Board> boards = {Board(), Board(11, 13), Board(26, 99), Board(2, 2), Board()};
+    read_custom_pieces_board(boards[0]);
+    boards[2].set_piece(Cell(25, 50), WHITE_CANNON);
+    boards[2].set_piece(Cell(3, 60), BLACK_BOMBTOWER);
+    boards[2].set_current_teams_turn(BLACK);
+    boards[3].set_current_teams_turn(NONE);
+    boards[4].set_piece(Cell(4, 4), WHITE_SMILEY);
+    for (int turn = 0; turn < 30 && boards[0].winner() == NONE; ++turn) {
+        MoveList moves = boards[0].get_moves();
+        Board next = boards[0];
+        next.make_move(moves[rand() % moves.size()]);
+        boards.push_back(next);
+    }
+    Board read;
+    for (const Board& board : boards) {
+        string text = write_position(board);
+        assertm(text.find('\n') == string::npos, "expected a position to be on one line");
+        read_position(text, read);
+        assertm(read == board && read.get_current_teams_turn() == board.get_current_teams_turn() && read.hash() == board.hash(),
+                "expected a position to come back the same: " << text);
+        assertm(read.material(WHITE) == board.material(WHITE) && read.material(BLACK) == board.material(BLACK),
+                "expected a position's material to come back the same: " << text);
+    }
+    assertm(write_position(boards[2]).find("/26/") != string::npos, "expected more than 9 empty squares to be written as one number");
+    assertm(write_position(boards[4]).find("😀") != string::npos, "expected a piece without a letter to be written as itself");
+
+    // things that aren't positions
+    Board before = read;
+    for (string_view text : {"", "8 w", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBN w",
+                             "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR x", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w ",
+                             "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNX w", "27/27 w", "26P/26 w", "0KK/kk w", "Kk w", "K/k w", "K♫/kk w", "K\xe2/kk w"}) {
+        bool threw = false;
+        try {
+            read_position(text, read);
+        } catch (invalid_argument e) {
+            threw = true;
+        }
+        assertm(threw, "expected reading something that isn't a position to throw: " << text);
+        assertm(read == before, "expected a position that can't be read to leave the board alone");
+    }
+    string too_high = "8";
+    for (int rank = 1; rank < 100; ++rank) {
+        too_high += "/8";
+    }
+    bool threw = false;
+    try {
+        read_position(too_high + " w", read);
+    } catch (invalid_argument e) {
+        threw = true;
+    }
+    assertm(threw, "expected a board more than 99 squares high to throw");
+}
+
+// makes sure positions come back the same out of a position database, in
+// any order and from many threads at once
+void test_position_database() {
+    const char* file_name = "position_database_test.bin";
+    vector<Board> boards = {Board(), Board(), Board(26, 99), Board(2, 2)};
+    read_custom_pieces_board(boards[1]);
+    boards[1].set_current_teams_turn(BLACK);
+    boards[2].set_piece(Cell(25, 98), WHITE_CANNON);
+    boards[3].set_current_teams_turn(NONE);
+    for (int turn = 0; turn < 200; ++turn) {
+        Board next = boards.back().winner() == NONE && boards.back().get_width() == 8 ? boards.back() : Board();
+        MoveList moves = next.get_moves();
+        next.make_move(moves[rand() % moves.size()]);
+        boards.push_back(next);
+    }
+    {
+        PositionDatabaseWriter writer(file_name);
+        for (const Board& board : boards) {
+            writer.add(board);
+        }
+    }
+    auto same = [](const Board& a, const Board& b) {
+        return a == b && a.get_current_teams_turn() == b.get_current_teams_turn() && a.hash() == b.hash() &&
+               a.material(WHITE) == b.material(WHITE) && a.material(BLACK) == b.material(BLACK);
+    };
+    {
+        PositionDatabase database(file_name);
+        assertm(database.size() == boards.size(), "expected the database to have every position");
+        Board board;
+        for (size_t i = boards.size(); i-- > 0;) {
+            database.get(i, board);
+            assertm(same(board, boards[i]), "expected position " << i << " to come back the same");
+        }
+        assertm(same(database[1], boards[1]), "expected a position looked up with [] to come back the same");
+
+        atomic<int> num_visited(0), num_same(0);
+        database.for_each(4, [&](uint64_t index, const Board& board) {
+            ++num_visited;
+            if (same(board, boards[index])) {
+                ++num_same;
+            }
+        });
+        assertm(num_visited == static_cast<int>(boards.size()) && num_same == num_visited, "expected for_each to visit every position once");
+
+        bool threw = false;
+        try {
+            database.for_each(3, [&](uint64_t index, const Board&) {
+                if (index == 100) {
+                    throw logic_error("stop");
+                }
+            });
+        } catch (logic_error e) {
+            threw = true;
+        }
+        assertm(threw, "expected for_each to throw what visit throws");
+        threw = false;
+        try {
+            database.get(boards.size(), board);
+        } catch (out_of_range e) {
+            threw = true;
+        }
+        assertm(threw, "expected getting a position that isn't there to throw");
+    }
+    {
+        // the starting position (43 bytes), its index entry and the tables
+        PositionDatabaseWriter writer(file_name);
+        writer.add(Board());
+    }
+    ifstream written(file_name, ios::binary | ios::ate);
+    assertm(written.tellg() == 24 + 48 + 56 + 16, "expected positions to be small");
+    written.close();
+
+    // converting boards, with and without whose turn it is, and lines of
+    // position notation, from among lines that are neither
+    stringstream text;
+    text << "game 1:\n"
+         << boards[1] << '\n'
+         << "Black's turn.\n"
+         << "Black chose to move ♟ from a7 to a6 (.)\n\n"
+         << boards[5] << write_position(boards[2]) << '\n';
+    {
+        PositionDatabaseWriter writer(file_name);
+        uint64_t num_converted = convert_text_positions(text, writer);
+        assertm(num_converted == 3, "expected every position to be converted, but got " << num_converted);
+    }
+    {
+        PositionDatabase database(file_name);
+        Board white_to_move = boards[5];
+        white_to_move.set_current_teams_turn(WHITE);
+        assertm(database.size() == 3 && same(database[0], boards[1]) && same(database[1], white_to_move) && same(database[2], boards[2]),
+                "expected converted positions to come back the same");
+    }
+    {
+        // indented text that isn't a board, a board too wide to be one, one
+        // with pieces that don't exist, one that doesn't come out the same
+        // when it's written back and a line that isn't a position are all
+        // skipped
+        string wide = "   " + string(28, 'a') + "\n 2 " + string(28, '.') + " 2\n 1 " + string(28, '.') + " 1\n   " + string(28, 'a') + "\n";
+        stringstream garbage;
+        garbage << "   just some indented text\n"
+                << "that goes on\n"
+                << "   and on\n"
+                << wide << "   ab\n 2 xy 2\n 1 .. 1\n   ab\n"
+                << "   ab\n 2 ♜♜ 5\n 1 .. 1\n   ab\n"
+                << "hello w\n"
+                << boards[1];
+        PositionDatabaseWriter writer(file_name);
+        uint64_t num_converted = convert_text_positions(garbage, writer);
+        assertm(num_converted == 1, "expected only the real board to be converted, but got " << num_converted);
+        writer.close();
+        PositionDatabase database(file_name);
+        Board white_to_move = boards[1];
+        white_to_move.set_current_teams_turn(WHITE);
+        assertm(database.size() == 1 && same(database[0], white_to_move), "expected the real board to come back the same");
+    }
+    {
+        // a header that says there are 2^64 - 1 positions (one more than that
+        // wraps around to 0), and tables with no pieces and no offsets
+        string bytes("SCPD\x01\0\0\0", 8);
+        bytes += string(8, '\xff');
+        bytes += string("\x18\0\0\0\0\0\0\0", 8);
+        bytes += string(8, '\0');
+        ofstream file(file_name, ios::binary);
+        file.write(bytes.data(), bytes.size());
+    }
+    bool threw = false;
+    try {
+        PositionDatabase database(file_name);
+    } catch (invalid_argument e) {
+        threw = true;
+    }
+    assertm(threw, "expected a database that says it has more positions than it does to throw");
+    remove(file_name);
+
+    threw = false;
+    try {
+        PositionDatabase database("unit_tests.cpp");
+    } catch (invalid_argument e) {
+        threw = true;
+    }
+    assertm(threw, "expected opening something that isn't a position database to throw");
+}
+
+// makes sure an opening book has the moves of the games it was built from,
+// and that the AI plays the best of them
+void test_opening_book() {
+    const char* file_name = "opening_book_test.bin";
+    Move a3(Cell(0, 1), Cell(0, 2)), b3(Cell(1, 1), Cell(1, 2)), a6(Cell(0, 6), Cell(0, 5));
+    OpeningBookBuilder builder(2);
+    // a3 won 3 games out of 3, b3 lost 5 out of 5
+    for (int game = 0; game < 8; ++game) {
+        GameRecord record;
+        record.moves = {game < 3 ? a3 : b3, a6, Move(Cell(0, 2), Cell(0, 3))};
+        record.winner = game < 3 ? WHITE : BLACK;
+        builder.add_game(record);
+    }
+    assertm(builder.size() == 4, "expected only the first 2 moves of each game to go in the book");
+    // and some games on another board, which shouldn't get in the way
+    for (int game = 0; game < 10; ++game) {
+        GameRecord record;
+        record.start = Board(11, 13);
+        Board board = record.start;
+        for (int turn = 0; turn < 4; ++turn) {
+            MoveList moves = board.get_moves();
+            record.moves.push_back(moves[rand() % moves.size()]);
+            board.make_move(record.moves.back());
+        }
+        builder.add_game(record);
+    }
+    builder.write(file_name);
+
+    {
+        OpeningBook book(file_name);
+        ifstream written(file_name, ios::binary | ios::ate);
+        assertm(static_cast<uint64_t>(written.tellg()) == 16 + 24 * book.size() && book.size() == builder.size(),
+                "expected every move to be in the book, 24 bytes each");
+        Board start;
+        vector<BookMove> moves = book.get_moves(start);
+        assertm(moves.size() == 2 && moves[0].move == PackedMove(b3) && moves[0].games == 5 && moves[0].losses == 5 &&
+                    moves[1].move == PackedMove(a3) && moves[1].games == 3 && moves[1].wins == 3,
+                "expected the starting position's book moves, most played first");
+        Board after_a3 = start;
+        after_a3.make_move(a3);
+        moves = book.get_moves(after_a3);
+        assertm(moves.size() == 1 && moves[0].move == PackedMove(a6) && moves[0].losses == 3, "expected the book to have black's moves too");
+
+        Move chosen;
+        bool found = book.choose_move(start, start.get_moves(), 1, chosen);
+        assertm(found && chosen == a3, "expected the best scoring book move to be chosen");
+        found = book.choose_move(start, start.get_moves(), 4, chosen);
+        assertm(found && chosen == b3, "expected only moves played in enough games to be chosen");
+        found = book.choose_move(start, start.get_moves(), 6, chosen);
+        assertm(!found, "expected no move to be chosen when none were played in enough games");
+        MoveList only_b3;
+        only_b3.push_back(PackedMove(b3));
+        found = book.choose_move(start, only_b3, 1, chosen);
+        assertm(found && chosen == b3, "expected only moves that are in the list of moves to be chosen");
+        found = book.choose_move(Board(11, 11), Board(11, 11).get_moves(), 1, chosen);
+        assertm(!found, "expected no move for a position that isn't in the book");
+
+        AIPlayer ai(WHITE, 1, 3);
+        ai.use_opening_book(&book);
+        Move played = ai.get_move(start, start.get_moves());
+        assertm(played == a3 && ai.last_search_info().from_book, "expected the AI to play the book move");
+        Board out_of_book = start;
+        out_of_book.make_move(b3);
+        out_of_book.make_move(a6);
+        ai.get_move(out_of_book, out_of_book.get_moves());
+        assertm(!ai.last_search_info().from_book && ai.last_search_info().depth == 3, "expected the AI to search out of the book");
+    }
+    remove(file_name);
+
+    GameRecord illegal;
+    illegal.moves = {Move(Cell(0, 0), Cell(7, 7))};
+    bool threw = false;
+    try {
+        builder.add_game(illegal);
+    } catch (invalid_argument e) {
+        threw = true;
+    }
+    assertm(threw, "expected a game with a move that isn't legal to throw");
+    threw = false;
+    try {
+        OpeningBook book("unit_tests.cpp");
+    } catch (invalid_argument e) {
+        threw = true;
+    }
+    assertm(threw, "expected opening something that isn't an opening book to throw");
+}
+
+// makes sure a BackgroundWriter writes everything it's given, from any thread
+void test_background_writer() {
+    const char* file_name = "background_writer_test.txt";
+    {
+        BackgroundWriter writer(file_name);
+        vector<thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&writer, i]() {
+                for (int line = 0; line < 1000; ++line) {
+                    writer.write(string(1, 'a' + i) + "\n");
+                }
+            });
+        }
+        for (thread& t : threads) {
+            t.join();
+        }
+    }
+    ifstream in(file_name);
+    int counts[4] = {};
+    string line;
+    while (getline(in, line)) {
+        assertm(line.size() == 1 && line[0] >= 'a' && line[0] < 'a' + 4, "expected every line to be written whole");
+        ++counts[line[0] - 'a'];
+    }
+    in.close();
+    remove(file_name);
+    assertm(counts[0] == 1000 && counts[1] == 1000 && counts[2] == 1000 && counts[3] == 1000, "expected every line to be written");
+}
+
+// checks the smaller counts in perft_suite.txt (run from the folder it's in)
+void test_perft_suite() {
+    ifstream in("perft_suite.txt");
+    assertm(in, "expected to find perft_suite.txt");
+    vector<PerftPosition> positions = read_perft_suite(in);
+    assertm(positions.size() >= 10, "expected to read every position in perft_suite.txt");
+    for (PerftPosition& position : positions) {
+        for (pair<int, uint64_t> expected : position.counts) {
+            if (expected.second > 200000) {
+                continue;
+            }
+            uint64_t count = perft(position.board, expected.first);
+            ostringstream temp;
+            temp << "expected perft " << expected.first << " of " << position.name << " to be " << expected.second << " but got " << count;
+            assertm(count == expected.second, temp.str());
+        }
+    }
+
+    // dividing it up between threads gives the same total
+    Board board;
+    read_custom_pieces_board(board);
+    uint64_t total = 0;
+    for (pair<Move, uint64_t> count : perft_divide(board, 3, 3)) {
+        total += count.second;
+    }
+    assertm(total == perft(board, 3), "expected perft_divide to add up to perft");
 }
 
 int main() {
@@ -210,5 +1545,31 @@ int main() {
 
     test_winner(m);
 
+    test_bitboard_moves();
+    test_get_piece_moves();
+    test_long_pawn_moves();
+    test_piece_subclasses();
+    test_custom_pieces();
+    test_piece_codes();
+    test_packed_moves();
+    test_legal_moves();
+    test_material();
+    test_get_captures();
+    test_attack_tables();
+    test_unmake_move();
+    test_hash();
+    test_transposition_table();
+    test_ai_player();
+    test_ai_player_budget();
+    test_tournament();
+    test_game_records();
+    test_write_board();
+    test_read_board_sizes();
+    test_position_notation();
+    test_position_database();
+    test_opening_book();
+    test_background_writer();
+    test_perft_suite();
+
     cout << "all tests passed" << endl;
 }
\ No newline at end of file
@@ -101,3 +101,64 @@ istream &operator>>(istream &is, UTF8CodePoint &cp) {
     // Should never reach this line
     return is;
 }
+
+size_t encode_utf8(char32_t code_point, char bytes[4]) {
+    if (code_point < 0x80) {
+        bytes[0] = code_point;
+        return 1;
+    } else if (code_point < 0x800) {
+        bytes[0] = 0b1100'0000 | (code_point >> 6 & 0b0001'1111);
+        bytes[1] = 0b1000'0000 | (code_point & 0b0011'1111);
+        return 2;
+    } else if (code_point < 0x10000) {
+        bytes[0] = 0b1110'0000 | (code_point >> 12 & 0b0000'1111);
+        bytes[1] = 0b1000'0000 | (code_point >> 6 & 0b0011'1111);
+        bytes[2] = 0b1000'0000 | (code_point & 0b0011'1111);
+        return 3;
+    } else {
+        bytes[0] = 0b1111'0000 | (code_point >> 18 & 0b0000'0111);
+        bytes[1] = 0b1000'0000 | (code_point >> 12 & 0b0011'1111);
+        bytes[2] = 0b1000'0000 | (code_point >> 6 & 0b0011'1111);
+        bytes[3] = 0b1000'0000 | (code_point & 0b0011'1111);
+        return 4;
+    }
+}
+
+void append_utf8(std::string &bytes, char32_t code_point) {
+    char encoded[4];
+    bytes.append(encoded, encode_utf8(code_point, encoded));
+}
+
+size_t decode_utf8(const char *bytes, size_t size, char32_t &code_point) {
+    if (size == 0) {
+        return 0;
+    }
+    unsigned char first = bytes[0];
+    size_t num_bytes;
+    if ((first & 0b1000'0000) == 0b0000'0000) {
+        code_point = first;
+        return 1;
+    } else if ((first & 0b1110'0000) == 0b1100'0000) {
+        num_bytes = 2;
+        code_point = first & 0b0001'1111;
+    } else if ((first & 0b1111'0000) == 0b1110'0000) {
+        num_bytes = 3;
+        code_point = first & 0b0000'1111;
+    } else if ((first & 0b1111'1000) == 0b1111'0000) {
+        num_bytes = 4;
+        code_point = first & 0b0000'0111;
+    } else {
+        return 0;
+    }
+    if (size < num_bytes) {
+        return 0;
+    }
+    for (size_t i = 1; i < num_bytes; ++i) {
+        unsigned char byte = bytes[i];
+        if ((byte & 0b1100'0000) != 0b1000'0000) {
+            return 0;
+        }
+        code_point = code_point << 6 | (byte & 0b0011'1111);
+    }
+    return num_bytes;
+}
@@ -23,4 +23,14 @@ class UTF8CodePoint {
     friend istream& operator>>(istream& is, UTF8CodePoint& cp);
 };
 
+// The same encoding as operator<< and operator>>, for code that works on
+// bytes in memory rather than streams.
+// Writes the UTF-8 bytes of code_point to bytes, returning how many there are.
+size_t encode_utf8(char32_t code_point, char bytes[4]);
+// Adds the UTF-8 bytes of code_point to the end of bytes.
+void append_utf8(std::string& bytes, char32_t code_point);
+// Decodes the code point at the start of the size bytes at bytes. Returns how
+// many bytes it took up, or 0 if they don't start with a valid one.
+size_t decode_utf8(const char* bytes, size_t size, char32_t& code_point);
+
 #endif  // _UTF8_CODE_POINT_